@@ -0,0 +1,508 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// A* search with ALT (A*, Landmarks, Triangle inequality) lower bounds. For every
+// landmark L the distances d(L, v) and d(v, L) are precomputed, and
+// d(v, t) >= max(d(L, t) - d(L, v), d(v, L) - d(t, L)) steers the search towards
+// the target. Landmarks are picked greedily, each the vertex farthest from those
+// already chosen. Preprocessing runs two Dijkstras per landmark and keeps
+// 2 * landmark_count weights per vertex.
+template <typename Weight>
+class AltRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    static constexpr size_t DEFAULT_LANDMARK_COUNT = 16;
+
+    explicit AltRouter(const Graph& graph, size_t landmark_count = DEFAULT_LANDMARK_COUNT);
+
+    struct RouteInfo {
+        Weight weight;
+        std::vector<EdgeId> edges;
+    };
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    // Writes the edges of the route into edges, reusing its capacity, and returns
+    // the route weight
+    std::optional<Weight> BuildRoute(VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
+
+    // Bounds computed before edges got heavier are still valid lower bounds, so only
+    // lighter, added or moved edges lower the landmark distances (for the same
+    // landmarks). A decrease-only Dijkstra per landmark, seeded from the changed
+    // edges, visits just the vertices whose distances drop
+    void Repair(const std::vector<EdgeUpdate<Weight>>& updates);
+
+    const std::vector<VertexId>& GetLandmarks() const {
+        return landmarks_;
+    }
+
+private:
+    static constexpr Weight ZERO_WEIGHT = WeightTraits<Weight>::ZERO_WEIGHT;
+    static constexpr Weight INFINITE_WEIGHT = WeightTraits<Weight>::INFINITE_WEIGHT;
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+
+    // Reverse adjacency in CSR form, used for the distances to the landmarks
+    struct ReverseEdge {
+        VertexId from;
+        Weight weight;
+    };
+
+    struct HeapItem {
+        Weight key;
+        VertexId vertex;
+        bool operator>(const HeapItem& other) const {
+            return key > other.key;
+        }
+    };
+
+    // Per-thread buffers. weights/prev_edges/bounds are valid only where
+    // stamps == epoch, so nothing has to be cleared between searches
+    struct Scratch {
+        std::vector<Weight> weights;
+        std::vector<Weight> bounds;  // lower bound of the distance to the target
+        std::vector<EdgeId> prev_edges;
+        std::vector<uint32_t> stamps;
+        std::vector<HeapItem> heap;
+        uint32_t epoch = 0;
+
+        void Prepare(size_t vertex_count) {
+            if (stamps.size() < vertex_count) {
+                weights.resize(vertex_count);
+                bounds.resize(vertex_count);
+                prev_edges.resize(vertex_count);
+                stamps.resize(vertex_count, 0);
+            }
+            heap.clear();
+            if (++epoch == 0) {
+                std::fill(stamps.begin(), stamps.end(), 0);
+                epoch = 1;
+            }
+        }
+        bool IsReached(VertexId vertex) const {
+            return stamps[vertex] == epoch;
+        }
+    };
+
+    static Scratch& GetScratch() {
+        thread_local Scratch scratch;
+        return scratch;
+    }
+
+    void BuildReverseGraph();
+    // Moves the reverse edge of a changed edge to its current head and weight
+    void PatchReverseEdge(EdgeId edge_id);
+    // Calls handle_edge(tail, weight) for the edges into vertex
+    template <typename EdgeHandler>
+    void ForEachReverseEdge(VertexId vertex, EdgeHandler handle_edge) const;
+    void SelectLandmarks(size_t landmark_count);
+    // Plain Dijkstra from source over the graph, or over its reverse
+    void ComputeDistances(VertexId source, bool is_reverse, std::vector<Weight>& distances) const;
+    // Lowers the distances of the landmark in rows (from_landmarks_ or
+    // to_landmarks_) over the changed edges and whatever they improve
+    void DecreaseDistances(size_t landmark, bool is_reverse, const std::vector<EdgeId>& changed_edges,
+                           std::vector<Weight>& rows, std::vector<HeapItem>& heap) const;
+    Weight LowerBound(VertexId vertex, VertexId target) const;
+
+    const Graph& graph_;
+
+    static constexpr size_t NO_SLOT = std::numeric_limits<size_t>::max();
+    static constexpr VertexId NO_VERTEX = std::numeric_limits<VertexId>::max();
+    // The reverse CSR is rebuilt once its overflow and dead slots make up more than
+    // this fraction of the edges
+    static constexpr size_t REVERSE_REBUILD_DIVISOR = 8;
+
+    std::vector<size_t> reverse_offsets_;
+    std::vector<ReverseEdge> reverse_edges_;
+    // Edges moved or added by Repair, by head; their tails and weights are read
+    // from the graph. The CSR slots they left have +inf weight
+    std::vector<std::vector<EdgeId>> reverse_overflow_;
+    size_t reverse_overflow_count_ = 0;
+    size_t reverse_dead_slot_count_ = 0;
+    // By edge id: its CSR slot or NO_SLOT, and the head it is stored under
+    std::vector<size_t> reverse_slots_;
+    std::vector<VertexId> reverse_heads_;
+
+    std::vector<VertexId> landmarks_;
+    // Vertex-major, [vertex * landmark count + landmark], so one bound reads
+    // two contiguous rows
+    std::vector<Weight> from_landmarks_;  // d(L, v)
+    std::vector<Weight> to_landmarks_;    // d(v, L)
+};
+
+template <typename Weight>
+AltRouter<Weight>::AltRouter(const Graph& graph, size_t landmark_count)
+    : graph_(graph)
+{
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+    BuildReverseGraph();
+    SelectLandmarks(std::min(landmark_count, graph.GetVertexCount()));
+}
+
+template <typename Weight>
+void AltRouter<Weight>::BuildReverseGraph() {
+    const size_t vertex_count = graph_.GetVertexCount();
+    reverse_offsets_.assign(vertex_count + 1, 0);
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        ++reverse_offsets_[graph_.GetEdge(edge_id).to + 1];
+    }
+    for (size_t vertex = 0; vertex < vertex_count; ++vertex) {
+        reverse_offsets_[vertex + 1] += reverse_offsets_[vertex];
+    }
+    reverse_edges_.resize(graph_.GetEdgeCount());
+    reverse_slots_.resize(graph_.GetEdgeCount());
+    reverse_heads_.resize(graph_.GetEdgeCount());
+    std::vector<size_t> fill(reverse_offsets_.begin(), reverse_offsets_.end() - 1);
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        reverse_slots_[edge_id] = fill[edge.to];
+        reverse_heads_[edge_id] = edge.to;
+        reverse_edges_[fill[edge.to]++] = {edge.from, edge.weight};
+    }
+    std::vector<std::vector<EdgeId>>().swap(reverse_overflow_);
+    reverse_overflow_count_ = 0;
+    reverse_dead_slot_count_ = 0;
+}
+
+template <typename Weight>
+void AltRouter<Weight>::PatchReverseEdge(EdgeId edge_id) {
+    const auto& edge = graph_.GetEdge(edge_id);
+    if (edge_id >= reverse_slots_.size()) {
+        reverse_slots_.resize(edge_id + 1, NO_SLOT);
+        reverse_heads_.resize(edge_id + 1, NO_VERTEX);
+    }
+    size_t& slot = reverse_slots_[edge_id];
+    VertexId& head = reverse_heads_[edge_id];
+    if (head == edge.to) {
+        if (slot != NO_SLOT) {
+            reverse_edges_[slot] = {edge.from, edge.weight};
+        }
+        return;
+    }
+    if (slot != NO_SLOT) {
+        reverse_edges_[slot].weight = INFINITE_WEIGHT;
+        slot = NO_SLOT;
+        ++reverse_dead_slot_count_;
+    } else if (head != NO_VERTEX) {
+        auto& overflow = reverse_overflow_[head];
+        overflow.erase(std::find(overflow.begin(), overflow.end(), edge_id));
+        --reverse_overflow_count_;
+    }
+    if (reverse_overflow_.empty()) {
+        reverse_overflow_.resize(graph_.GetVertexCount());
+    }
+    reverse_overflow_[edge.to].push_back(edge_id);
+    ++reverse_overflow_count_;
+    head = edge.to;
+}
+
+template <typename Weight>
+template <typename EdgeHandler>
+void AltRouter<Weight>::ForEachReverseEdge(VertexId vertex, EdgeHandler handle_edge) const {
+    for (size_t i = reverse_offsets_[vertex]; i < reverse_offsets_[vertex + 1]; ++i) {
+        handle_edge(reverse_edges_[i].from, reverse_edges_[i].weight);
+    }
+    if (!reverse_overflow_.empty()) {
+        for (const EdgeId edge_id : reverse_overflow_[vertex]) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            handle_edge(edge.from, edge.weight);
+        }
+    }
+}
+
+template <typename Weight>
+void AltRouter<Weight>::ComputeDistances(VertexId source, bool is_reverse,
+                                         std::vector<Weight>& distances) const {
+    distances.assign(graph_.GetVertexCount(), INFINITE_WEIGHT);
+    std::vector<HeapItem> heap;
+    const auto heap_compare = std::greater<HeapItem>{};
+
+    distances[source] = ZERO_WEIGHT;
+    heap.push_back({ZERO_WEIGHT, source});
+    auto relax = [&](VertexId vertex, Weight weight) {
+        if (weight < distances[vertex]) {
+            distances[vertex] = weight;
+            heap.push_back({weight, vertex});
+            std::push_heap(heap.begin(), heap.end(), heap_compare);
+        }
+    };
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_compare);
+        const HeapItem item = heap.back();
+        heap.pop_back();
+        if (item.key > distances[item.vertex]) {
+            continue;
+        }
+        if (is_reverse) {
+            ForEachReverseEdge(item.vertex, [&](VertexId from, Weight weight) {
+                relax(from, item.key + weight);
+            });
+        } else {
+            for (const auto& edge : graph_.GetIncidentEdges(item.vertex)) {
+                relax(edge.to, item.key + edge.weight);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+void AltRouter<Weight>::SelectLandmarks(size_t landmark_count) {
+    const size_t vertex_count = graph_.GetVertexCount();
+    from_landmarks_.resize(vertex_count * landmark_count);
+    to_landmarks_.resize(vertex_count * landmark_count);
+    if (landmark_count == 0) {
+        return;
+    }
+
+    // separation[v]: smallest round-trip distance from v to a chosen landmark.
+    // Vertices not reachable from or to any landmark yet come first, so every
+    // component of the graph gets landmarks
+    std::vector<Weight> separation(vertex_count, INFINITE_WEIGHT);
+    std::vector<Weight> from_distances;
+    std::vector<Weight> to_distances;
+
+    // The first landmark is the vertex farthest from vertex 0
+    ComputeDistances(0, false, from_distances);
+    VertexId next = 0;
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        if (from_distances[vertex] != INFINITE_WEIGHT && from_distances[vertex] > from_distances[next]) {
+            next = vertex;
+        }
+    }
+
+    while (landmarks_.size() < landmark_count) {
+        const size_t landmark = landmarks_.size();
+        landmarks_.push_back(next);
+        ComputeDistances(next, false, from_distances);
+        ComputeDistances(next, true, to_distances);
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            from_landmarks_[vertex * landmark_count + landmark] = from_distances[vertex];
+            to_landmarks_[vertex * landmark_count + landmark] = to_distances[vertex];
+            if (from_distances[vertex] != INFINITE_WEIGHT || to_distances[vertex] != INFINITE_WEIGHT) {
+                const Weight round_trip = from_distances[vertex] != INFINITE_WEIGHT
+                                          && to_distances[vertex] != INFINITE_WEIGHT
+                    ? from_distances[vertex] + to_distances[vertex]
+                    : std::min(from_distances[vertex], to_distances[vertex]);
+                separation[vertex] = std::min(separation[vertex], round_trip);
+            }
+        }
+        separation[next] = ZERO_WEIGHT;
+
+        next = static_cast<VertexId>(std::max_element(separation.begin(), separation.end()) - separation.begin());
+        if (separation[next] == ZERO_WEIGHT) {
+            break;  // every vertex is a landmark already
+        }
+    }
+
+    // Fewer landmarks than requested: compact the rows
+    const size_t chosen_count = landmarks_.size();
+    if (chosen_count < landmark_count) {
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            for (size_t landmark = 0; landmark < chosen_count; ++landmark) {
+                from_landmarks_[vertex * chosen_count + landmark] = from_landmarks_[vertex * landmark_count + landmark];
+                to_landmarks_[vertex * chosen_count + landmark] = to_landmarks_[vertex * landmark_count + landmark];
+            }
+        }
+        from_landmarks_.resize(vertex_count * chosen_count);
+        to_landmarks_.resize(vertex_count * chosen_count);
+    }
+}
+
+template <typename Weight>
+void AltRouter<Weight>::Repair(const std::vector<EdgeUpdate<Weight>>& updates) {
+    std::vector<EdgeId> changed_edges;
+    changed_edges.reserve(updates.size());
+    for (const auto& update : updates) {
+        changed_edges.push_back(update.id);
+    }
+    std::sort(changed_edges.begin(), changed_edges.end());
+    changed_edges.erase(std::unique(changed_edges.begin(), changed_edges.end()), changed_edges.end());
+
+    for (const EdgeId edge_id : changed_edges) {
+        PatchReverseEdge(edge_id);
+    }
+    if ((reverse_overflow_count_ + reverse_dead_slot_count_) * REVERSE_REBUILD_DIVISOR > graph_.GetEdgeCount()) {
+        BuildReverseGraph();
+    }
+
+    const bool has_lighter_edges = std::any_of(updates.begin(), updates.end(), [this](const auto& update) {
+        const auto& edge = graph_.GetEdge(update.id);
+        return edge.weight < update.old_edge.weight || edge.from != update.old_edge.from
+            || edge.to != update.old_edge.to;
+    });
+    if (!has_lighter_edges) {
+        return;
+    }
+    // Heavier edges among the seeds improve nothing: the rows already satisfy
+    // their old, lighter weights
+    std::vector<HeapItem> heap;
+    for (size_t landmark = 0; landmark < landmarks_.size(); ++landmark) {
+        DecreaseDistances(landmark, false, changed_edges, from_landmarks_, heap);
+        DecreaseDistances(landmark, true, changed_edges, to_landmarks_, heap);
+    }
+}
+
+template <typename Weight>
+void AltRouter<Weight>::DecreaseDistances(size_t landmark, bool is_reverse,
+                                          const std::vector<EdgeId>& changed_edges, std::vector<Weight>& rows,
+                                          std::vector<HeapItem>& heap) const {
+    const size_t landmark_count = landmarks_.size();
+    auto distance = [&](VertexId vertex) -> Weight& {
+        return rows[vertex * landmark_count + landmark];
+    };
+    const auto heap_compare = std::greater<HeapItem>{};
+    heap.clear();
+    auto relax = [&](VertexId vertex, Weight weight) {
+        if (weight < distance(vertex)) {
+            distance(vertex) = weight;
+            heap.push_back({weight, vertex});
+            std::push_heap(heap.begin(), heap.end(), heap_compare);
+        }
+    };
+
+    for (const EdgeId edge_id : changed_edges) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        const VertexId tail = is_reverse ? edge.to : edge.from;
+        if (distance(tail) != INFINITE_WEIGHT && edge.weight != INFINITE_WEIGHT) {
+            relax(is_reverse ? edge.from : edge.to, distance(tail) + edge.weight);
+        }
+    }
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_compare);
+        const HeapItem item = heap.back();
+        heap.pop_back();
+        if (item.key > distance(item.vertex)) {
+            continue;
+        }
+        if (is_reverse) {
+            ForEachReverseEdge(item.vertex, [&](VertexId from, Weight weight) {
+                relax(from, item.key + weight);
+            });
+        } else {
+            for (const auto& edge : graph_.GetIncidentEdges(item.vertex)) {
+                relax(edge.to, item.key + edge.weight);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+Weight AltRouter<Weight>::LowerBound(VertexId vertex, VertexId target) const {
+    const size_t landmark_count = landmarks_.size();
+    const Weight* from_vertex = from_landmarks_.data() + vertex * landmark_count;
+    const Weight* from_target = from_landmarks_.data() + target * landmark_count;
+    const Weight* to_vertex = to_landmarks_.data() + vertex * landmark_count;
+    const Weight* to_target = to_landmarks_.data() + target * landmark_count;
+
+    Weight bound = ZERO_WEIGHT;
+    for (size_t landmark = 0; landmark < landmark_count; ++landmark) {
+        // L reaches vertex but not target, or target reaches L but vertex does not:
+        // target is unreachable from vertex
+        if ((from_vertex[landmark] != INFINITE_WEIGHT && from_target[landmark] == INFINITE_WEIGHT)
+            || (to_vertex[landmark] == INFINITE_WEIGHT && to_target[landmark] != INFINITE_WEIGHT)) {
+            return INFINITE_WEIGHT;
+        }
+        // Only positive differences count, and unsigned weights cannot go below zero
+        if (from_vertex[landmark] != INFINITE_WEIGHT && from_target[landmark] > from_vertex[landmark]) {
+            bound = std::max(bound, from_target[landmark] - from_vertex[landmark]);
+        }
+        if (to_target[landmark] != INFINITE_WEIGHT && to_vertex[landmark] > to_target[landmark]) {
+            bound = std::max(bound, to_vertex[landmark] - to_target[landmark]);
+        }
+    }
+    return bound;
+}
+
+template <typename Weight>
+std::optional<typename AltRouter<Weight>::RouteInfo> AltRouter<Weight>::BuildRoute(
+    VertexId from, VertexId to) const {
+    std::vector<EdgeId> edges;
+    const auto weight = BuildRoute(from, to, edges);
+    if (!weight) {
+        return std::nullopt;
+    }
+    return RouteInfo{*weight, std::move(edges)};
+}
+
+template <typename Weight>
+std::optional<Weight> AltRouter<Weight>::BuildRoute(VertexId from, VertexId to, std::vector<EdgeId>& edges) const {
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    edges.clear();
+    Scratch& scratch = GetScratch();
+    scratch.Prepare(graph_.GetVertexCount());
+    auto& heap = scratch.heap;
+    const auto heap_compare = std::greater<HeapItem>{};
+
+    const Weight from_bound = LowerBound(from, to);
+    if (from_bound == INFINITE_WEIGHT) {
+        return std::nullopt;
+    }
+    scratch.stamps[from] = scratch.epoch;
+    scratch.weights[from] = ZERO_WEIGHT;
+    scratch.bounds[from] = from_bound;
+    scratch.prev_edges[from] = NO_EDGE;
+    heap.push_back({from_bound, from});
+
+    bool is_found = false;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_compare);
+        const HeapItem item = heap.back();
+        heap.pop_back();
+        if (item.key > scratch.weights[item.vertex] + scratch.bounds[item.vertex]) {
+            continue;
+        }
+        if (item.vertex == to) {
+            is_found = true;
+            break;
+        }
+        const Weight weight = scratch.weights[item.vertex];
+        for (const auto& edge : graph_.GetIncidentEdges(item.vertex)) {
+            const Weight candidate_weight = weight + edge.weight;
+            if (!scratch.IsReached(edge.to)) {
+                scratch.stamps[edge.to] = scratch.epoch;
+                scratch.weights[edge.to] = INFINITE_WEIGHT;
+                scratch.bounds[edge.to] = LowerBound(edge.to, to);
+            }
+            if (candidate_weight >= scratch.weights[edge.to] || scratch.bounds[edge.to] == INFINITE_WEIGHT) {
+                continue;
+            }
+            scratch.weights[edge.to] = candidate_weight;
+            scratch.prev_edges[edge.to] = edge.id;
+            heap.push_back({candidate_weight + scratch.bounds[edge.to], edge.to});
+            std::push_heap(heap.begin(), heap.end(), heap_compare);
+        }
+    }
+    if (!is_found) {
+        return std::nullopt;
+    }
+
+    for (VertexId vertex = to; vertex != from;) {
+        const EdgeId edge_id = scratch.prev_edges[vertex];
+        edges.push_back(edge_id);
+        vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(edges.begin(), edges.end());
+    return scratch.weights[to];
+}
+
+}  // namespace graph
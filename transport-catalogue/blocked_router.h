@@ -0,0 +1,420 @@
+#pragma once
+
+#include "graph.h"
+#include "parallel.h"
+#include "route_repair.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace graph {
+
+namespace detail {
+
+// Min-plus update of one row: row_weights[j] = min(row_weights[j], weight_to_via + via_weights[j]),
+// taking the last edge from via_prev_edges when the route through via wins.
+// Written without branches so that it vectorizes as it is for other weight types.
+template <typename Weight, typename EdgeIdType>
+void RelaxRowScalar(Weight weight_to_via, const Weight* via_weights,
+                    const EdgeIdType* via_prev_edges, Weight* row_weights,
+                    EdgeIdType* row_prev_edges, size_t count) {
+    for (size_t j = 0; j < count; ++j) {
+        const Weight candidate = weight_to_via + via_weights[j];
+        const bool is_better = candidate < row_weights[j];
+        row_weights[j] = is_better ? candidate : row_weights[j];
+        row_prev_edges[j] = is_better ? via_prev_edges[j] : row_prev_edges[j];
+    }
+}
+
+template <typename Weight, typename EdgeIdType, typename = void>
+struct MinPlusKernel {
+    static void RelaxRow(Weight weight_to_via, const Weight* via_weights,
+                         const EdgeIdType* via_prev_edges, Weight* row_weights,
+                         EdgeIdType* row_prev_edges, size_t count) {
+        RelaxRowScalar(weight_to_via, via_weights, via_prev_edges, row_weights, row_prev_edges,
+                       count);
+    }
+};
+
+#if defined(__AVX2__) || defined(__SSE2__)
+// double weights with 64-bit edge ids: both arrays have the same lane count,
+// so one comparison mask selects the weight and the edge
+template <typename EdgeIdType>
+struct MinPlusKernel<double, EdgeIdType, std::enable_if_t<sizeof(EdgeIdType) == 8>> {
+    static void RelaxRow(double weight_to_via, const double* via_weights,
+                         const EdgeIdType* via_prev_edges, double* row_weights,
+                         EdgeIdType* row_prev_edges, size_t count) {
+        size_t j = 0;
+#if defined(__AVX2__)
+        const __m256d via = _mm256_set1_pd(weight_to_via);
+        for (; j + 4 <= count; j += 4) {
+            const __m256d candidate = _mm256_add_pd(via, _mm256_loadu_pd(via_weights + j));
+            const __m256d current = _mm256_loadu_pd(row_weights + j);
+            const __m256d is_better = _mm256_cmp_pd(candidate, current, _CMP_LT_OQ);
+            _mm256_storeu_pd(row_weights + j, _mm256_blendv_pd(current, candidate, is_better));
+
+            const __m256i prev_candidate = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(via_prev_edges + j));
+            const __m256i prev_current = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(row_prev_edges + j));
+            const __m256i prev = _mm256_blendv_epi8(prev_current, prev_candidate,
+                                                    _mm256_castpd_si256(is_better));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(row_prev_edges + j), prev);
+        }
+#else
+        const __m128d via = _mm_set1_pd(weight_to_via);
+        for (; j + 2 <= count; j += 2) {
+            const __m128d candidate = _mm_add_pd(via, _mm_loadu_pd(via_weights + j));
+            const __m128d current = _mm_loadu_pd(row_weights + j);
+            const __m128d is_better = _mm_cmplt_pd(candidate, current);
+            _mm_storeu_pd(row_weights + j, _mm_or_pd(_mm_and_pd(is_better, candidate),
+                                                     _mm_andnot_pd(is_better, current)));
+
+            const __m128i mask = _mm_castpd_si128(is_better);
+            const __m128i prev_candidate = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(via_prev_edges + j));
+            const __m128i prev_current = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(row_prev_edges + j));
+            const __m128i prev = _mm_or_si128(_mm_and_si128(mask, prev_candidate),
+                                              _mm_andnot_si128(mask, prev_current));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row_prev_edges + j), prev);
+        }
+#endif
+        RelaxRowScalar(weight_to_via, via_weights + j, via_prev_edges + j, row_weights + j,
+                       row_prev_edges + j, count - j);
+    }
+};
+
+// float weights with 32-bit edge ids, the CompactRouter table
+template <typename EdgeIdType>
+struct MinPlusKernel<float, EdgeIdType, std::enable_if_t<sizeof(EdgeIdType) == 4>> {
+    static void RelaxRow(float weight_to_via, const float* via_weights,
+                         const EdgeIdType* via_prev_edges, float* row_weights,
+                         EdgeIdType* row_prev_edges, size_t count) {
+        size_t j = 0;
+#if defined(__AVX2__)
+        const __m256 via = _mm256_set1_ps(weight_to_via);
+        for (; j + 8 <= count; j += 8) {
+            const __m256 candidate = _mm256_add_ps(via, _mm256_loadu_ps(via_weights + j));
+            const __m256 current = _mm256_loadu_ps(row_weights + j);
+            const __m256 is_better = _mm256_cmp_ps(candidate, current, _CMP_LT_OQ);
+            _mm256_storeu_ps(row_weights + j, _mm256_blendv_ps(current, candidate, is_better));
+
+            const __m256i prev_candidate = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(via_prev_edges + j));
+            const __m256i prev_current = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(row_prev_edges + j));
+            const __m256i prev = _mm256_blendv_epi8(prev_current, prev_candidate,
+                                                    _mm256_castps_si256(is_better));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(row_prev_edges + j), prev);
+        }
+#else
+        const __m128 via = _mm_set1_ps(weight_to_via);
+        for (; j + 4 <= count; j += 4) {
+            const __m128 candidate = _mm_add_ps(via, _mm_loadu_ps(via_weights + j));
+            const __m128 current = _mm_loadu_ps(row_weights + j);
+            const __m128 is_better = _mm_cmplt_ps(candidate, current);
+            _mm_storeu_ps(row_weights + j, _mm_or_ps(_mm_and_ps(is_better, candidate),
+                                                     _mm_andnot_ps(is_better, current)));
+
+            const __m128i mask = _mm_castps_si128(is_better);
+            const __m128i prev_candidate = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(via_prev_edges + j));
+            const __m128i prev_current = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(row_prev_edges + j));
+            const __m128i prev = _mm_or_si128(_mm_and_si128(mask, prev_candidate),
+                                              _mm_andnot_si128(mask, prev_current));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row_prev_edges + j), prev);
+        }
+#endif
+        RelaxRowScalar(weight_to_via, via_weights + j, via_prev_edges + j, row_weights + j,
+                       row_prev_edges + j, count - j);
+    }
+};
+#endif
+
+}  // namespace detail
+
+// All-pairs router with the same results as graph::Router, but the table is two flat
+// row-major matrices (weights with +inf for "no route" and last edges) padded to
+// whole TILE_SIZE x TILE_SIZE tiles and kept in a single allocation. Floyd-Warshall
+// runs tile by tile: for each diagonal tile the row/column tiles and then all
+// remaining tiles are relaxed in parallel, and the inner min-plus loop is vectorized.
+//
+// TableWeight and TableEdgeId set the cell types of the table. Narrower types
+// (see CompactRouter) shrink the table; BuildRoute then sums the original edge
+// weights of the route, so its weight keeps the precision of Weight.
+template <typename Weight, typename TableWeight = Weight, typename TableEdgeId = EdgeId>
+class BlockedRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    static constexpr size_t TILE_SIZE = 64;
+
+    // The whole table as one block of bytes: TableWeight[stride * stride]
+    // followed by TableEdgeId[stride * stride]
+    struct TableView {
+        const std::byte* data;
+        size_t size;
+        size_t stride;
+    };
+
+    // thread_count == 0 means std::thread::hardware_concurrency()
+    explicit BlockedRouter(const Graph& graph, size_t thread_count = 0);
+    // Answers queries from a table saved with GetTable() for the same graph, e.g. a
+    // memory-mapped file. The table is neither copied nor owned and must outlive the router
+    BlockedRouter(const Graph& graph, TableView table);
+
+    struct RouteInfo {
+        Weight weight;
+        std::vector<EdgeId> edges;
+    };
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    // Writes the edges of the route into edges, reusing its capacity, and returns
+    // the route weight
+    std::optional<Weight> BuildRoute(VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
+
+    // Recomputes the rows of the sources whose routes may have changed after updates
+    // of edges already applied to the graph. A borrowed table is copied first
+    void Repair(const std::vector<EdgeUpdate<Weight>>& updates);
+
+    TableView GetTable() const {
+        return {reinterpret_cast<const std::byte*>(weights_), GetTableSize(stride_), stride_};
+    }
+    static size_t GetTableSize(size_t stride) {
+        return stride * stride * (sizeof(TableWeight) + sizeof(TableEdgeId));
+    }
+
+private:
+    static constexpr TableWeight ZERO_WEIGHT = WeightTraits<TableWeight>::ZERO_WEIGHT;
+    static constexpr TableWeight INFINITE_WEIGHT = WeightTraits<TableWeight>::INFINITE_WEIGHT;
+    static constexpr TableEdgeId NO_EDGE = std::numeric_limits<TableEdgeId>::max();
+
+    void InitializeTable(const Graph& graph);
+    void RelaxTile(size_t row_tile, size_t column_tile, size_t via_tile);
+
+    size_t Index(VertexId from, VertexId to) const {
+        return from * stride_ + to;
+    }
+
+    const Graph& graph_;
+    size_t vertex_count_ = 0;
+    size_t stride_ = 0;
+    size_t thread_count_ = 1;
+    std::unique_ptr<std::byte[]> table_;
+    TableWeight* weights_ = nullptr;
+    TableEdgeId* prev_edges_ = nullptr;
+};
+
+// 8 bytes per vertex pair: 4-byte weights (float for floating point Weight) and
+// 32-bit last-edge ids
+template <typename Weight>
+using CompactRouter = BlockedRouter<Weight, typename WeightTraits<Weight>::CompactWeight, uint32_t>;
+
+template <typename Weight, typename TableWeight, typename TableEdgeId>
+BlockedRouter<Weight, TableWeight, TableEdgeId>::BlockedRouter(const Graph& graph,
+                                                               size_t thread_count)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+    , stride_((vertex_count_ + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE)
+    , thread_count_(parallel::GetThreadCount(thread_count))
+{
+    if (graph.GetEdgeCount() >= static_cast<size_t>(NO_EDGE)) {
+        throw std::length_error("Too many edges for the routing table edge id type");
+    }
+    InitializeTable(graph);
+
+    // The workers are started once and go through the phases of all via tiles
+    // together, each taking every worker_count-th tile of a phase. A barrier
+    // separates the phases, as each one reads the tiles the previous one wrote
+    const size_t tile_count = stride_ / TILE_SIZE;
+    const size_t worker_count = std::max<size_t>(1, std::min(thread_count_, tile_count * tile_count));
+    parallel::Barrier barrier(worker_count);
+    parallel::RunWorkers(worker_count, [&](size_t worker) {
+        for (size_t via_tile = 0; via_tile < tile_count; ++via_tile) {
+            // Phase 1: the diagonal tile depends only on itself
+            if (worker == 0) {
+                RelaxTile(via_tile, via_tile, via_tile);
+            }
+            barrier.ArriveAndWait();
+
+            // Phase 2: tiles in the same tile row or column as the diagonal one
+            for (size_t task = worker; task < 2 * tile_count; task += worker_count) {
+                const size_t other_tile = task % tile_count;
+                if (other_tile == via_tile) {
+                    continue;
+                }
+                if (task < tile_count) {
+                    RelaxTile(via_tile, other_tile, via_tile);
+                } else {
+                    RelaxTile(other_tile, via_tile, via_tile);
+                }
+            }
+            barrier.ArriveAndWait();
+
+            // Phase 3: everything else, using the tiles finished in phase 2
+            for (size_t task = worker; task < tile_count * tile_count; task += worker_count) {
+                const size_t row_tile = task / tile_count;
+                const size_t column_tile = task % tile_count;
+                if (row_tile != via_tile && column_tile != via_tile) {
+                    RelaxTile(row_tile, column_tile, via_tile);
+                }
+            }
+            barrier.ArriveAndWait();
+        }
+    });
+}
+
+template <typename Weight, typename TableWeight, typename TableEdgeId>
+BlockedRouter<Weight, TableWeight, TableEdgeId>::BlockedRouter(const Graph& graph, TableView table)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+    , stride_(table.stride)
+{
+    if (stride_ < vertex_count_ || stride_ % TILE_SIZE != 0 || table.size != GetTableSize(stride_)) {
+        throw std::invalid_argument("Routing table does not match the graph");
+    }
+    // The table is only read from here on
+    weights_ = reinterpret_cast<TableWeight*>(const_cast<std::byte*>(table.data));
+    prev_edges_ = reinterpret_cast<TableEdgeId*>(
+        const_cast<std::byte*>(table.data) + stride_ * stride_ * sizeof(TableWeight));
+}
+
+template <typename Weight, typename TableWeight, typename TableEdgeId>
+void BlockedRouter<Weight, TableWeight, TableEdgeId>::Repair(const std::vector<EdgeUpdate<Weight>>& updates) {
+    if (graph_.GetEdgeCount() >= static_cast<size_t>(NO_EDGE)) {
+        throw std::length_error("Too many edges for the routing table edge id type");
+    }
+    if (!table_) {
+        const size_t table_size = GetTableSize(stride_);
+        auto table = std::make_unique<std::byte[]>(table_size);
+        std::memcpy(table.get(), weights_, table_size);
+        table_ = std::move(table);
+        weights_ = reinterpret_cast<TableWeight*>(table_.get());
+        prev_edges_ = reinterpret_cast<TableEdgeId*>(table_.get() + stride_ * stride_ * sizeof(TableWeight));
+    }
+
+    std::vector<Weight> weights;
+    std::vector<EdgeId> prev_edges;
+    for (VertexId from = 0; from < vertex_count_; ++from) {
+        TableWeight* row_weights = weights_ + Index(from, 0);
+        TableEdgeId* row_prev_edges = prev_edges_ + Index(from, 0);
+        const bool is_affected = IsTreeAffected(graph_, updates,
+            [row_weights](VertexId vertex) {
+                return row_weights[vertex] == INFINITE_WEIGHT ? WeightTraits<Weight>::INFINITE_WEIGHT
+                                                              : static_cast<Weight>(row_weights[vertex]);
+            },
+            [row_prev_edges](VertexId vertex) {
+                return row_prev_edges[vertex] == NO_EDGE ? NO_TREE_EDGE : static_cast<EdgeId>(row_prev_edges[vertex]);
+            });
+        if (!is_affected) {
+            continue;
+        }
+        BuildShortestPathTree(graph_, from, weights, prev_edges);
+        for (VertexId to = 0; to < vertex_count_; ++to) {
+            row_weights[to] = static_cast<TableWeight>(weights[to]);
+            row_prev_edges[to] = prev_edges[to] == NO_TREE_EDGE ? NO_EDGE : static_cast<TableEdgeId>(prev_edges[to]);
+        }
+    }
+}
+
+template <typename Weight, typename TableWeight, typename TableEdgeId>
+void BlockedRouter<Weight, TableWeight, TableEdgeId>::InitializeTable(const Graph& graph) {
+    const size_t cell_count = stride_ * stride_;
+    table_ = std::make_unique<std::byte[]>(GetTableSize(stride_));
+    weights_ = reinterpret_cast<TableWeight*>(table_.get());
+    prev_edges_ = reinterpret_cast<TableEdgeId*>(table_.get() + cell_count * sizeof(TableWeight));
+    std::fill(weights_, weights_ + cell_count, INFINITE_WEIGHT);
+    std::fill(prev_edges_, prev_edges_ + cell_count, NO_EDGE);
+
+    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        weights_[Index(vertex, vertex)] = ZERO_WEIGHT;
+        for (const auto& edge : graph.GetIncidentEdges(vertex)) {
+            if (edge.weight < WeightTraits<Weight>::ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+            const size_t index = Index(vertex, edge.to);
+            const auto weight = static_cast<TableWeight>(edge.weight);
+            if (weight < weights_[index]) {
+                weights_[index] = weight;
+                prev_edges_[index] = static_cast<TableEdgeId>(edge.id);
+            }
+        }
+    }
+}
+
+template <typename Weight, typename TableWeight, typename TableEdgeId>
+void BlockedRouter<Weight, TableWeight, TableEdgeId>::RelaxTile(size_t row_tile,
+                                                                size_t column_tile,
+                                                                size_t via_tile) {
+    const size_t column_begin = column_tile * TILE_SIZE;
+    for (size_t via = via_tile * TILE_SIZE; via < (via_tile + 1) * TILE_SIZE; ++via) {
+        const TableWeight* via_weights = weights_ + Index(via, column_begin);
+        const TableEdgeId* via_prev_edges = prev_edges_ + Index(via, column_begin);
+        for (size_t from = row_tile * TILE_SIZE; from < (row_tile + 1) * TILE_SIZE; ++from) {
+            const TableWeight weight_to_via = weights_[Index(from, via)];
+            if (weight_to_via == INFINITE_WEIGHT) {
+                continue;
+            }
+            detail::MinPlusKernel<TableWeight, TableEdgeId>::RelaxRow(
+                weight_to_via, via_weights, via_prev_edges, weights_ + Index(from, column_begin),
+                prev_edges_ + Index(from, column_begin), TILE_SIZE);
+        }
+    }
+}
+
+template <typename Weight, typename TableWeight, typename TableEdgeId>
+std::optional<typename BlockedRouter<Weight, TableWeight, TableEdgeId>::RouteInfo>
+BlockedRouter<Weight, TableWeight, TableEdgeId>::BuildRoute(VertexId from, VertexId to) const {
+    std::vector<EdgeId> edges;
+    const auto weight = BuildRoute(from, to, edges);
+    if (!weight) {
+        return std::nullopt;
+    }
+    return RouteInfo{*weight, std::move(edges)};
+}
+
+template <typename Weight, typename TableWeight, typename TableEdgeId>
+std::optional<Weight> BlockedRouter<Weight, TableWeight, TableEdgeId>::BuildRoute(
+    VertexId from, VertexId to, std::vector<EdgeId>& edges) const {
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    edges.clear();
+    if (weights_[Index(from, to)] == INFINITE_WEIGHT) {
+        return std::nullopt;
+    }
+    for (VertexId vertex = to; vertex != from;) {
+        const EdgeId edge_id = prev_edges_[Index(from, vertex)];
+        edges.push_back(edge_id);
+        vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    if constexpr (std::is_same_v<Weight, TableWeight>) {
+        return weights_[Index(from, to)];
+    } else {
+        Weight weight{};
+        for (const EdgeId edge_id : edges) {
+            weight = weight + graph_.GetEdge(edge_id).weight;
+        }
+        return weight;
+    }
+}
+
+}  // namespace graph
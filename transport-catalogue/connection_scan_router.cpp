@@ -0,0 +1,186 @@
+#include "connection_scan_router.h"
+#include "route_units.h"
+
+#include <algorithm>
+#include <limits>
+#include <tuple>
+
+namespace transport {
+
+namespace {
+constexpr double INFINITE_TIME = std::numeric_limits<double>::infinity();
+} // namespace
+
+ConnectionScanRouter::ConnectionScanRouter(const Catalogue& catalogue, double bus_velocity)
+    : velocity_m_per_min_(ToMetersPerMinute(bus_velocity)) {
+    for (const auto& [stop_name, stop] : catalogue.GetSortedAllStops()) {
+        stop_indices_[stop->name] = static_cast<StopIndex>(stops_.size());
+        stops_.push_back(stop);
+    }
+
+    for (const auto& [bus_name, bus] : catalogue.GetSortedAllBuses()) {
+        AddTrips(catalogue, bus, connections_);
+    }
+    std::sort(connections_.begin(), connections_.end(), IsEarlier);
+}
+
+void ConnectionScanRouter::AddBus(const Catalogue& catalogue, const Bus* bus) {
+    RemoveBus(bus->number);
+    std::vector<Connection> connections;
+    AddTrips(catalogue, bus, connections);
+    std::sort(connections.begin(), connections.end(), IsEarlier);
+
+    const size_t old_size = connections_.size();
+    connections_.insert(connections_.end(), connections.begin(), connections.end());
+    std::inplace_merge(connections_.begin(), connections_.begin() + old_size, connections_.end(), IsEarlier);
+}
+
+void ConnectionScanRouter::RemoveBus(std::string_view bus_name) {
+    const auto it = bus_trips_.find(bus_name);
+    if (it == bus_trips_.end()) {
+        return;
+    }
+    const TripRange removed = it->second;
+    bus_trips_.erase(it);
+    connections_.erase(std::remove_if(connections_.begin(), connections_.end(),
+                                      [removed](const Connection& connection) {
+                                          return connection.trip - removed.first < removed.count;
+                                      }),
+                       connections_.end());
+    // Shifting the later trips down keeps their order, and so the connection order
+    for (Connection& connection : connections_) {
+        if (connection.trip > removed.first) {
+            connection.trip -= removed.count;
+        }
+    }
+    trip_buses_.erase(trip_buses_.begin() + removed.first, trip_buses_.begin() + removed.first + removed.count);
+    for (auto& [name, trips] : bus_trips_) {
+        if (trips.first > removed.first) {
+            trips.first -= removed.count;
+        }
+    }
+}
+
+bool ConnectionScanRouter::HasBus(const Bus* bus) const {
+    const auto it = bus_trips_.find(bus->number);
+    return it != bus_trips_.end() && trip_buses_[it->second.first] == bus;
+}
+
+bool ConnectionScanRouter::IsEarlier(const Connection& lhs, const Connection& rhs) {
+    // A ride of zero length departs when the previous one of its trip arrives,
+    // so the trip and the position keep the rides of a trip in order
+    return std::tie(lhs.departure, lhs.arrival, lhs.trip, lhs.position)
+           < std::tie(rhs.departure, rhs.arrival, rhs.trip, rhs.position);
+}
+
+void ConnectionScanRouter::AddTrips(const Catalogue& catalogue, const Bus* bus,
+                                    std::vector<Connection>& connections) {
+    if (bus->stops.size() < 2 || bus->departures.empty()) return;
+
+    // A trip of a non-circular bus goes to the last stop and back
+    std::vector<StopIndex> trip_stops;
+    for (const Stop* stop : bus->stops) {
+        trip_stops.push_back(stop_indices_.at(stop->name));
+    }
+    if (!bus->is_circle) {
+        trip_stops.insert(trip_stops.end(), trip_stops.rbegin() + 1, trip_stops.rend());
+    }
+    std::vector<double> ride_times(trip_stops.size() - 1);
+    for (size_t i = 0; i + 1 < trip_stops.size(); ++i) {
+        ride_times[i] = catalogue.GetDistance(stops_[trip_stops[i]], stops_[trip_stops[i + 1]])
+                        / velocity_m_per_min_;
+    }
+
+    bus_trips_[bus->number] = {static_cast<TripIndex>(trip_buses_.size()),
+                               static_cast<TripIndex>(bus->departures.size())};
+    for (const double departure : bus->departures) {
+        const TripIndex trip = static_cast<TripIndex>(trip_buses_.size());
+        trip_buses_.push_back(bus);
+        double time = departure;
+        for (size_t i = 0; i < ride_times.size(); ++i) {
+            connections.push_back({time, time + ride_times[i], trip_stops[i], trip_stops[i + 1], trip,
+                                   static_cast<uint32_t>(i)});
+            time += ride_times[i];
+        }
+    }
+}
+
+std::optional<ConnectionScanRouter::Journey> ConnectionScanRouter::FindJourney(std::string_view from,
+                                                                               std::string_view to,
+                                                                               double departure_time) const {
+    const auto from_it = stop_indices_.find(from);
+    const auto to_it = stop_indices_.find(to);
+    if (from_it == stop_indices_.end() || to_it == stop_indices_.end()) {
+        return std::nullopt;
+    }
+    const StopIndex source = from_it->second;
+    const StopIndex target = to_it->second;
+
+    Scratch& scratch = GetScratch();
+    if (scratch.stop_stamps.size() < stops_.size()) {
+        scratch.arrivals.resize(stops_.size());
+        scratch.parents.resize(stops_.size());
+        scratch.stop_stamps.resize(stops_.size(), 0);
+    }
+    if (scratch.trip_stamps.size() < trip_buses_.size()) {
+        scratch.boardings.resize(trip_buses_.size());
+        scratch.trip_stamps.resize(trip_buses_.size(), 0);
+    }
+    if (++scratch.epoch == 0) {
+        std::fill(scratch.stop_stamps.begin(), scratch.stop_stamps.end(), 0);
+        std::fill(scratch.trip_stamps.begin(), scratch.trip_stamps.end(), 0);
+        scratch.epoch = 1;
+    }
+    const uint32_t epoch = scratch.epoch;
+    auto arrival_at = [&scratch, epoch](StopIndex stop) {
+        return scratch.stop_stamps[stop] == epoch ? scratch.arrivals[stop] : INFINITE_TIME;
+    };
+
+    scratch.stop_stamps[source] = epoch;
+    scratch.arrivals[source] = departure_time;
+
+    // Connections leaving before departure_time are never taken
+    auto first = std::partition_point(connections_.begin(), connections_.end(),
+                                      [departure_time](const Connection& connection) {
+                                          return connection.departure < departure_time;
+                                      });
+    for (auto it = first; it != connections_.end(); ++it) {
+        const Connection& connection = *it;
+        // Later connections cannot arrive before the target is already reached
+        if (connection.departure >= arrival_at(target)) {
+            break;
+        }
+        const ConnectionIndex index = static_cast<ConnectionIndex>(it - connections_.begin());
+        if (scratch.trip_stamps[connection.trip] != epoch) {
+            if (arrival_at(connection.from) > connection.departure) {
+                continue;
+            }
+            scratch.trip_stamps[connection.trip] = epoch;
+            scratch.boardings[connection.trip] = index;
+        }
+        if (connection.arrival < arrival_at(connection.to)) {
+            scratch.stop_stamps[connection.to] = epoch;
+            scratch.arrivals[connection.to] = connection.arrival;
+            scratch.parents[connection.to] = {scratch.boardings[connection.trip], index};
+        }
+    }
+
+    const double arrival = arrival_at(target);
+    if (arrival == INFINITE_TIME) {
+        return std::nullopt;
+    }
+    Journey journey{arrival - departure_time, {}};
+    for (StopIndex stop = target; stop != source;) {
+        const Parent& parent = scratch.parents[stop];
+        const Connection& board = connections_[parent.board];
+        const Connection& alight = connections_[parent.alight];
+        journey.legs.push_back({stops_[board.from], trip_buses_[board.trip],
+                                static_cast<int>(alight.position - board.position + 1),
+                                board.departure - scratch.arrivals[board.from], alight.arrival - board.departure});
+        stop = board.from;
+    }
+    std::reverse(journey.legs.begin(), journey.legs.end());
+    return journey;
+}
+
+}  // namespace transport
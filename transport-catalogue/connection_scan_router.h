@@ -0,0 +1,109 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "domain.h"
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace transport {
+
+// Earliest-arrival router over the bus timetables (Connection Scan Algorithm).
+// Every trip is cut into connections, rides between two consecutive stops, kept
+// in one flat array sorted by departure time. A query is a single forward pass
+// over the array from the requested departure time: no graph, no priority queue.
+// Waiting is the real time until the boarded trip leaves, bus_wait_time does not
+// apply. Buses without departures are not used
+class ConnectionScanRouter {
+public:
+    struct Leg {
+        const Stop* board_stop;
+        const Bus* bus;
+        int span_count;
+        double wait_time;
+        double ride_time;
+    };
+
+    struct Journey {
+        double total_time;  // from the departure time to the arrival
+        std::vector<Leg> legs;
+    };
+
+    ConnectionScanRouter(const Catalogue& catalogue, double bus_velocity);
+
+    // departure_time is in minutes after midnight. std::nullopt for an unknown stop
+    // or a target no trip of the day gets to
+    std::optional<Journey> FindJourney(std::string_view from, std::string_view to, double departure_time) const;
+
+    // Incremental updates; the catalogue must already contain the change.
+    // AddBus replaces the trips of a bus added before, so it also recomputes them
+    // after SetDistance. RemoveBus drops the trips and renumbers the later ones, so
+    // the trip ids stay dense however often buses are replaced
+    void AddBus(const Catalogue& catalogue, const Bus* bus);
+    void RemoveBus(std::string_view bus_name);
+    // Whether the trips of this very bus are held, and not those of a bus of the
+    // same name replaced since or none at all
+    bool HasBus(const Bus* bus) const;
+    size_t GetTripCount() const {
+        return trip_buses_.size();
+    }
+
+private:
+    using StopIndex = uint32_t;
+    using TripIndex = uint32_t;
+    using ConnectionIndex = uint32_t;
+
+    struct Connection {
+        double departure;
+        double arrival;
+        StopIndex from;
+        StopIndex to;
+        TripIndex trip;
+        uint32_t position;  // of the ride in the trip
+    };
+
+    // How the best arrival at a stop was reached: the connections the trip was
+    // boarded and left at
+    struct Parent {
+        ConnectionIndex board;
+        ConnectionIndex alight;
+    };
+
+    // Consecutive trip ids of one bus
+    struct TripRange {
+        TripIndex first;
+        TripIndex count;
+    };
+
+    // Entries are valid only if stamped with the epoch of the current search
+    struct Scratch {
+        std::vector<double> arrivals;
+        std::vector<Parent> parents;
+        std::vector<uint32_t> stop_stamps;
+        std::vector<ConnectionIndex> boardings;
+        std::vector<uint32_t> trip_stamps;
+        uint32_t epoch = 0;
+    };
+
+    static Scratch& GetScratch() {
+        thread_local Scratch scratch;
+        return scratch;
+    }
+
+    static bool IsEarlier(const Connection& lhs, const Connection& rhs);
+    // Appends the connections of all trips of the bus, unsorted
+    void AddTrips(const Catalogue& catalogue, const Bus* bus, std::vector<Connection>& connections);
+
+    double velocity_m_per_min_ = 0.0;
+
+    std::vector<const Stop*> stops_;
+    std::unordered_map<std::string_view, StopIndex> stop_indices_;
+    std::vector<const Bus*> trip_buses_;
+    std::unordered_map<std::string_view, TripRange> bus_trips_;  // buses with trips
+    std::vector<Connection> connections_;
+};
+
+}  // namespace transport
@@ -0,0 +1,477 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Contraction Hierarchies over DirectedWeightedGraph. Vertices are contracted one
+// by one in the order of a lazily updated edge-difference priority; a shortcut
+// u->w is added for every u->v->w path that has no witness avoiding v. Queries run
+// a bidirectional Dijkstra that only goes up the hierarchy, and shortcuts are
+// unpacked back into the original edge ids.
+template <typename Weight>
+class ContractionHierarchy {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    explicit ContractionHierarchy(const Graph& graph);
+
+    struct RouteInfo {
+        Weight weight;
+        std::vector<EdgeId> edges;
+    };
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    // Writes the edges of the route into edges, reusing its capacity, and returns
+    // the route weight
+    std::optional<Weight> BuildRoute(VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
+
+    size_t GetShortcutCount() const {
+        return arcs_.size() - original_arc_count_;
+    }
+
+private:
+    using ArcId = size_t;
+
+    static constexpr Weight ZERO_WEIGHT = WeightTraits<Weight>::ZERO_WEIGHT;
+    static constexpr Weight INFINITE_WEIGHT = WeightTraits<Weight>::INFINITE_WEIGHT;
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+    static constexpr ArcId NO_ARC = std::numeric_limits<ArcId>::max();
+    // Witness searches give up after settling this many vertices; the shortcut
+    // is then added even if it may be redundant
+    static constexpr size_t WITNESS_SETTLE_LIMIT = 500;
+
+    // Either an original edge (edge != NO_EDGE) or a shortcut made of
+    // the two arcs lower: from->via and upper: via->to
+    struct Arc {
+        VertexId from;
+        VertexId to;
+        Weight weight;
+        EdgeId edge;
+        ArcId lower;
+        ArcId upper;
+    };
+
+    struct HeapItem {
+        Weight weight;
+        VertexId vertex;
+        bool operator>(const HeapItem& other) const {
+            return weight > other.weight;
+        }
+    };
+    // Binary min-heap kept with std::push_heap/pop_heap, so its buffer can be reused
+    using MinHeap = std::vector<HeapItem>;
+
+    // Dijkstra labels, valid only where stamps == epoch
+    struct SearchSpace {
+        std::vector<Weight> weights;
+        std::vector<ArcId> parent_arcs;
+        std::vector<uint32_t> stamps;
+        uint32_t epoch = 0;
+
+        void Prepare(size_t vertex_count) {
+            if (stamps.size() < vertex_count) {
+                weights.resize(vertex_count);
+                parent_arcs.resize(vertex_count);
+                stamps.resize(vertex_count, 0);
+            }
+            if (++epoch == 0) {
+                std::fill(stamps.begin(), stamps.end(), 0);
+                epoch = 1;
+            }
+        }
+        Weight GetWeight(VertexId vertex) const {
+            return stamps[vertex] == epoch ? weights[vertex] : INFINITE_WEIGHT;
+        }
+        void Set(VertexId vertex, Weight weight, ArcId parent_arc) {
+            stamps[vertex] = epoch;
+            weights[vertex] = weight;
+            parent_arcs[vertex] = parent_arc;
+        }
+    };
+
+    struct QueryScratch {
+        SearchSpace forward;
+        SearchSpace backward;
+        MinHeap forward_heap;
+        MinHeap backward_heap;
+        std::vector<ArcId> path_arcs;
+        std::vector<ArcId> unpack_stack;
+    };
+
+    static QueryScratch& GetQueryScratch() {
+        thread_local QueryScratch scratch;
+        return scratch;
+    }
+
+    // Adjacency of the not yet contracted part of the graph
+    struct ContractionState {
+        std::vector<std::vector<ArcId>> out_arcs;
+        std::vector<std::vector<ArcId>> in_arcs;
+        std::vector<bool> contracted;
+        std::vector<int> deleted_neighbours;
+        SearchSpace witness_space;
+        std::vector<HeapItem> witness_heap;
+    };
+
+    struct Shortcut {
+        ArcId lower;
+        ArcId upper;
+        Weight weight;
+    };
+
+    void Contract(size_t vertex_count);
+    std::vector<Shortcut> FindShortcuts(VertexId vertex, ContractionState& state) const;
+    void RunWitnessSearch(VertexId from, VertexId avoid, Weight limit,
+                          ContractionState& state) const;
+    void BuildSearchGraphs(size_t vertex_count);
+    void UnpackArc(ArcId arc_id, std::vector<EdgeId>& edges, std::vector<ArcId>& stack) const;
+
+    std::vector<Arc> arcs_;
+    size_t original_arc_count_ = 0;
+    std::vector<size_t> ranks_;
+
+    // Arcs going up the hierarchy grouped by their tail (forward search) and arcs
+    // coming down grouped by their head (backward search), in CSR layout
+    std::vector<size_t> up_offsets_;
+    std::vector<ArcId> up_arcs_;
+    std::vector<size_t> down_offsets_;
+    std::vector<ArcId> down_arcs_;
+};
+
+template <typename Weight>
+ContractionHierarchy<Weight>::ContractionHierarchy(const Graph& graph) {
+    const size_t vertex_count = graph.GetVertexCount();
+    arcs_.reserve(graph.GetEdgeCount());
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        // Loops never shorten a route, and +inf marks a removed edge
+        if (edge.from != edge.to && edge.weight != INFINITE_WEIGHT) {
+            arcs_.push_back({edge.from, edge.to, edge.weight, edge_id, NO_ARC, NO_ARC});
+        }
+    }
+    original_arc_count_ = arcs_.size();
+
+    Contract(vertex_count);
+    BuildSearchGraphs(vertex_count);
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::RunWitnessSearch(VertexId from, VertexId avoid, Weight limit,
+                                                    ContractionState& state) const {
+    // One-to-many search bounded by limit and WITNESS_SETTLE_LIMIT
+    SearchSpace& space = state.witness_space;
+    auto& heap = state.witness_heap;
+    const auto heap_compare = std::greater<HeapItem>{};
+    space.Prepare(state.out_arcs.size());
+    heap.clear();
+    space.Set(from, ZERO_WEIGHT, NO_ARC);
+    heap.push_back({ZERO_WEIGHT, from});
+
+    size_t settled = 0;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_compare);
+        const HeapItem item = heap.back();
+        heap.pop_back();
+        if (item.weight > space.weights[item.vertex]) {
+            continue;
+        }
+        if (item.weight > limit || ++settled > WITNESS_SETTLE_LIMIT) {
+            break;
+        }
+        for (const ArcId arc_id : state.out_arcs[item.vertex]) {
+            const Arc& arc = arcs_[arc_id];
+            if (arc.to == avoid) {
+                continue;
+            }
+            const Weight candidate_weight = item.weight + arc.weight;
+            if (candidate_weight < space.GetWeight(arc.to)) {
+                space.Set(arc.to, candidate_weight, arc_id);
+                heap.push_back({candidate_weight, arc.to});
+                std::push_heap(heap.begin(), heap.end(), heap_compare);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+std::vector<typename ContractionHierarchy<Weight>::Shortcut>
+ContractionHierarchy<Weight>::FindShortcuts(VertexId vertex, ContractionState& state) const {
+    // Only the lightest of parallel arcs matters for each neighbour
+    auto lightest_arcs = [this](const std::vector<ArcId>& arc_ids, auto neighbour_of) {
+        std::vector<ArcId> result;
+        for (const ArcId arc_id : arc_ids) {
+            const auto it = std::find_if(result.begin(), result.end(), [&](ArcId other) {
+                return neighbour_of(arcs_[other]) == neighbour_of(arcs_[arc_id]);
+            });
+            if (it == result.end()) {
+                result.push_back(arc_id);
+            } else if (arcs_[arc_id].weight < arcs_[*it].weight) {
+                *it = arc_id;
+            }
+        }
+        return result;
+    };
+    const auto in_arcs = lightest_arcs(state.in_arcs[vertex], [](const Arc& arc) {
+        return arc.from;
+    });
+    const auto out_arcs = lightest_arcs(state.out_arcs[vertex], [](const Arc& arc) {
+        return arc.to;
+    });
+
+    Weight max_out_weight = ZERO_WEIGHT;
+    for (const ArcId out_arc : out_arcs) {
+        max_out_weight = std::max(max_out_weight, arcs_[out_arc].weight);
+    }
+
+    std::vector<Shortcut> shortcuts;
+    for (const ArcId in_arc : in_arcs) {
+        const VertexId from = arcs_[in_arc].from;
+        RunWitnessSearch(from, vertex, arcs_[in_arc].weight + max_out_weight, state);
+        for (const ArcId out_arc : out_arcs) {
+            const VertexId to = arcs_[out_arc].to;
+            if (to == from) {
+                continue;
+            }
+            // A tentative label is a real path too, so it is a valid witness
+            const Weight weight = arcs_[in_arc].weight + arcs_[out_arc].weight;
+            if (state.witness_space.GetWeight(to) > weight) {
+                shortcuts.push_back({in_arc, out_arc, weight});
+            }
+        }
+    }
+    return shortcuts;
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::Contract(size_t vertex_count) {
+    ContractionState state;
+    state.out_arcs.resize(vertex_count);
+    state.in_arcs.resize(vertex_count);
+    state.contracted.assign(vertex_count, false);
+    state.deleted_neighbours.assign(vertex_count, 0);
+    for (ArcId arc_id = 0; arc_id < arcs_.size(); ++arc_id) {
+        state.out_arcs[arcs_[arc_id].from].push_back(arc_id);
+        state.in_arcs[arcs_[arc_id].to].push_back(arc_id);
+    }
+
+    auto priority = [&state](VertexId vertex, const std::vector<Shortcut>& shortcuts) {
+        const int removed_count =
+            static_cast<int>(state.in_arcs[vertex].size() + state.out_arcs[vertex].size());
+        return static_cast<int>(shortcuts.size()) - removed_count + state.deleted_neighbours[vertex];
+    };
+
+    using QueueItem = std::pair<int, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        queue.emplace(priority(vertex, FindShortcuts(vertex, state)), vertex);
+    }
+
+    ranks_.assign(vertex_count, 0);
+    size_t next_rank = 0;
+    while (!queue.empty()) {
+        const VertexId vertex = queue.top().second;
+        queue.pop();
+        if (state.contracted[vertex]) {
+            continue;
+        }
+        // Lazy update: the stored priority may be outdated by earlier contractions
+        const auto shortcuts = FindShortcuts(vertex, state);
+        const int current_priority = priority(vertex, shortcuts);
+        if (!queue.empty() && current_priority > queue.top().first) {
+            queue.emplace(current_priority, vertex);
+            continue;
+        }
+
+        for (const Shortcut& shortcut : shortcuts) {
+            const ArcId arc_id = arcs_.size();
+            const VertexId from = arcs_[shortcut.lower].from;
+            const VertexId to = arcs_[shortcut.upper].to;
+            arcs_.push_back({from, to, shortcut.weight, NO_EDGE, shortcut.lower, shortcut.upper});
+            state.out_arcs[from].push_back(arc_id);
+            state.in_arcs[to].push_back(arc_id);
+        }
+
+        // Detach the vertex from the remaining graph
+        auto drop_arcs_of = [this, vertex](std::vector<ArcId>& arc_ids) {
+            arc_ids.erase(std::remove_if(arc_ids.begin(), arc_ids.end(), [&](ArcId arc_id) {
+                return arcs_[arc_id].from == vertex || arcs_[arc_id].to == vertex;
+            }), arc_ids.end());
+        };
+        for (const ArcId arc_id : state.in_arcs[vertex]) {
+            drop_arcs_of(state.out_arcs[arcs_[arc_id].from]);
+            ++state.deleted_neighbours[arcs_[arc_id].from];
+        }
+        for (const ArcId arc_id : state.out_arcs[vertex]) {
+            drop_arcs_of(state.in_arcs[arcs_[arc_id].to]);
+            ++state.deleted_neighbours[arcs_[arc_id].to];
+        }
+        state.in_arcs[vertex].clear();
+        state.out_arcs[vertex].clear();
+        state.contracted[vertex] = true;
+        ranks_[vertex] = next_rank++;
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::BuildSearchGraphs(size_t vertex_count) {
+    up_offsets_.assign(vertex_count + 1, 0);
+    down_offsets_.assign(vertex_count + 1, 0);
+    for (const Arc& arc : arcs_) {
+        if (ranks_[arc.from] < ranks_[arc.to]) {
+            ++up_offsets_[arc.from + 1];
+        } else {
+            ++down_offsets_[arc.to + 1];
+        }
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        up_offsets_[vertex + 1] += up_offsets_[vertex];
+        down_offsets_[vertex + 1] += down_offsets_[vertex];
+    }
+
+    up_arcs_.resize(up_offsets_.back());
+    down_arcs_.resize(down_offsets_.back());
+    std::vector<size_t> up_fill(up_offsets_.begin(), up_offsets_.end() - 1);
+    std::vector<size_t> down_fill(down_offsets_.begin(), down_offsets_.end() - 1);
+    for (ArcId arc_id = 0; arc_id < arcs_.size(); ++arc_id) {
+        const Arc& arc = arcs_[arc_id];
+        if (ranks_[arc.from] < ranks_[arc.to]) {
+            up_arcs_[up_fill[arc.from]++] = arc_id;
+        } else {
+            down_arcs_[down_fill[arc.to]++] = arc_id;
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::UnpackArc(ArcId arc_id, std::vector<EdgeId>& edges,
+                                             std::vector<ArcId>& stack) const {
+    stack.assign(1, arc_id);
+    while (!stack.empty()) {
+        const Arc& arc = arcs_[stack.back()];
+        stack.pop_back();
+        if (arc.edge != NO_EDGE) {
+            edges.push_back(arc.edge);
+        } else {
+            stack.push_back(arc.upper);
+            stack.push_back(arc.lower);
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename ContractionHierarchy<Weight>::RouteInfo>
+ContractionHierarchy<Weight>::BuildRoute(VertexId from, VertexId to) const {
+    std::vector<EdgeId> edges;
+    const auto weight = BuildRoute(from, to, edges);
+    if (!weight) {
+        return std::nullopt;
+    }
+    return RouteInfo{*weight, std::move(edges)};
+}
+
+template <typename Weight>
+std::optional<Weight> ContractionHierarchy<Weight>::BuildRoute(VertexId from, VertexId to,
+                                                               std::vector<EdgeId>& edges) const {
+    const size_t vertex_count = ranks_.size();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    QueryScratch& scratch = GetQueryScratch();
+    SearchSpace& forward = scratch.forward;
+    SearchSpace& backward = scratch.backward;
+    forward.Prepare(vertex_count);
+    backward.Prepare(vertex_count);
+    forward.Set(from, ZERO_WEIGHT, NO_ARC);
+    backward.Set(to, ZERO_WEIGHT, NO_ARC);
+
+    const auto heap_compare = std::greater<HeapItem>{};
+    MinHeap& forward_heap = scratch.forward_heap;
+    MinHeap& backward_heap = scratch.backward_heap;
+    forward_heap.assign(1, {ZERO_WEIGHT, from});
+    backward_heap.assign(1, {ZERO_WEIGHT, to});
+
+    Weight best_weight = INFINITE_WEIGHT;
+    std::optional<VertexId> meeting_vertex;
+
+    auto step = [&](MinHeap& heap, SearchSpace& space, const SearchSpace& other_space,
+                    const std::vector<size_t>& offsets, const std::vector<ArcId>& arc_ids,
+                    bool is_forward) {
+        std::pop_heap(heap.begin(), heap.end(), heap_compare);
+        const HeapItem item = heap.back();
+        heap.pop_back();
+        if (item.weight > space.weights[item.vertex]) {
+            return;
+        }
+        if (const Weight total = item.weight + other_space.GetWeight(item.vertex);
+            total < best_weight) {
+            best_weight = total;
+            meeting_vertex = item.vertex;
+        }
+        for (size_t i = offsets[item.vertex]; i < offsets[item.vertex + 1]; ++i) {
+            const Arc& arc = arcs_[arc_ids[i]];
+            const VertexId next = is_forward ? arc.to : arc.from;
+            const Weight candidate_weight = item.weight + arc.weight;
+            if (candidate_weight < space.GetWeight(next)) {
+                space.Set(next, candidate_weight, arc_ids[i]);
+                heap.push_back({candidate_weight, next});
+                std::push_heap(heap.begin(), heap.end(), heap_compare);
+            }
+        }
+    };
+
+    while (!forward_heap.empty() || !backward_heap.empty()) {
+        const bool forward_done = forward_heap.empty() || !(forward_heap.front().weight < best_weight);
+        const bool backward_done = backward_heap.empty() || !(backward_heap.front().weight < best_weight);
+        if (forward_done && backward_done) {
+            break;
+        }
+        if (!forward_done) {
+            step(forward_heap, forward, backward, up_offsets_, up_arcs_, true);
+        }
+        if (!backward_done) {
+            step(backward_heap, backward, forward, down_offsets_, down_arcs_, false);
+        }
+    }
+
+    edges.clear();
+    if (!meeting_vertex) {
+        return std::nullopt;
+    }
+
+    std::vector<ArcId>& path_arcs = scratch.path_arcs;
+    path_arcs.clear();
+    for (VertexId vertex = *meeting_vertex; vertex != from;) {
+        const ArcId arc_id = forward.parent_arcs[vertex];
+        path_arcs.push_back(arc_id);
+        vertex = arcs_[arc_id].from;
+    }
+    std::reverse(path_arcs.begin(), path_arcs.end());
+    for (VertexId vertex = *meeting_vertex; vertex != to;) {
+        const ArcId arc_id = backward.parent_arcs[vertex];
+        path_arcs.push_back(arc_id);
+        vertex = arcs_[arc_id].to;
+    }
+
+    for (const ArcId arc_id : path_arcs) {
+        UnpackArc(arc_id, edges, scratch.unpack_stack);
+    }
+    return best_weight;
+}
+
+}  // namespace graph
@@ -0,0 +1,380 @@
+#pragma once
+
+#include "graph.h"
+#include "route_repair.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Answers each query with a binary-heap Dijkstra instead of precomputing all pairs.
+// Search buffers are thread_local and reused between queries; shortest path trees
+// of the last cache_capacity sources are kept in an LRU cache. BuildRoutes answers
+// many targets of one source from a single search.
+template <typename Weight>
+class DijkstraRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    static constexpr size_t DEFAULT_CACHE_CAPACITY = 32;
+
+    explicit DijkstraRouter(const Graph& graph, size_t cache_capacity = DEFAULT_CACHE_CAPACITY);
+
+    struct RouteInfo {
+        Weight weight;
+        std::vector<EdgeId> edges;
+    };
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    // Writes the edges of the route into edges, reusing its capacity, and returns
+    // the route weight
+    std::optional<Weight> BuildRoute(VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
+    // Same, but a source missing from the cache is searched in the per-thread
+    // buffers and not added to it, so no tree is allocated
+    std::optional<Weight> BuildRouteUncached(VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
+    std::vector<std::optional<RouteInfo>> BuildRoutes(VertexId from, const std::vector<VertexId>& targets) const;
+
+    // Drops the cached trees that may have changed after updates of edges already
+    // applied to the graph
+    void Repair(const std::vector<EdgeUpdate<Weight>>& updates);
+
+private:
+    static constexpr Weight ZERO_WEIGHT = WeightTraits<Weight>::ZERO_WEIGHT;
+    static constexpr Weight INFINITE_WEIGHT = WeightTraits<Weight>::INFINITE_WEIGHT;
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+
+    struct ShortestPathTree {
+        std::vector<Weight> weights;
+        std::vector<EdgeId> prev_edges;
+    };
+
+    struct HeapItem {
+        Weight weight;
+        VertexId vertex;
+        bool operator>(const HeapItem& other) const {
+            return weight > other.weight;
+        }
+    };
+
+    // Per-thread buffers. weights/prev_edges are valid only where stamps == epoch,
+    // so nothing has to be cleared between searches
+    struct Scratch {
+        std::vector<Weight> weights;
+        std::vector<EdgeId> prev_edges;
+        std::vector<uint32_t> stamps;
+        std::vector<uint32_t> target_stamps;  // target_stamps[v] == epoch: v is a target not yet settled
+        std::vector<HeapItem> heap;
+        uint32_t epoch = 0;
+
+        void Prepare(size_t vertex_count) {
+            if (stamps.size() < vertex_count) {
+                weights.resize(vertex_count);
+                prev_edges.resize(vertex_count);
+                stamps.resize(vertex_count, 0);
+                target_stamps.resize(vertex_count, 0);
+            }
+            heap.clear();
+            if (++epoch == 0) {
+                std::fill(stamps.begin(), stamps.end(), 0);
+                std::fill(target_stamps.begin(), target_stamps.end(), 0);
+                epoch = 1;
+            }
+        }
+        bool IsReached(VertexId vertex) const {
+            return stamps[vertex] == epoch;
+        }
+        Weight GetWeight(VertexId vertex) const {
+            return IsReached(vertex) ? weights[vertex] : INFINITE_WEIGHT;
+        }
+    };
+
+    static Scratch& GetScratch() {
+        thread_local Scratch scratch;
+        return scratch;
+    }
+
+    using Targets = ranges::Range<const VertexId*>;
+
+    // Stops as soon as all targets are popped from the heap; an empty range of
+    // targets builds the whole shortest path tree
+    void RunSearch(VertexId from, Targets targets, Scratch& scratch) const;
+    std::shared_ptr<const ShortestPathTree> GetCachedTree(VertexId from) const;
+    // The cached tree of the source, if any; the cache is left as it is otherwise
+    std::shared_ptr<const ShortestPathTree> FindCachedTree(VertexId from) const;
+    std::optional<Weight> BuildRouteFromTree(const ShortestPathTree& tree, VertexId from, VertexId to,
+                                             std::vector<EdgeId>& edges) const;
+    std::optional<Weight> BuildRouteFromScratch(VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
+    std::shared_ptr<const ShortestPathTree> BuildTree(VertexId from) const;
+
+    // Replaces the contents of edges with the path from the root of the tree to `to`
+    template <typename PrevEdgeGetter>
+    void CollectEdges(VertexId from, VertexId to, PrevEdgeGetter prev_edge, std::vector<EdgeId>& edges) const;
+
+    const Graph& graph_;
+    const size_t cache_capacity_;
+
+    using CacheList = std::list<std::pair<VertexId, std::shared_ptr<const ShortestPathTree>>>;
+    mutable std::mutex cache_mutex_;
+    mutable CacheList cache_list_;
+    mutable std::unordered_map<VertexId, typename CacheList::iterator> cache_index_;
+};
+
+template <typename Weight>
+DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph, size_t cache_capacity)
+    : graph_(graph)
+    , cache_capacity_(cache_capacity)
+{
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+template <typename Weight>
+void DijkstraRouter<Weight>::RunSearch(VertexId from, Targets targets, Scratch& scratch) const {
+    scratch.Prepare(graph_.GetVertexCount());
+    auto& heap = scratch.heap;
+    const auto heap_compare = std::greater<HeapItem>{};
+
+    size_t remaining_targets = 0;
+    for (const VertexId target : targets) {
+        if (scratch.target_stamps[target] != scratch.epoch) {
+            scratch.target_stamps[target] = scratch.epoch;
+            ++remaining_targets;
+        }
+    }
+
+    scratch.stamps[from] = scratch.epoch;
+    scratch.weights[from] = ZERO_WEIGHT;
+    scratch.prev_edges[from] = NO_EDGE;
+    heap.push_back({ZERO_WEIGHT, from});
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_compare);
+        const HeapItem item = heap.back();
+        heap.pop_back();
+        if (item.weight > scratch.weights[item.vertex]) {
+            continue;
+        }
+        if (scratch.target_stamps[item.vertex] == scratch.epoch) {
+            scratch.target_stamps[item.vertex] = 0;
+            if (--remaining_targets == 0) {
+                return;
+            }
+        }
+        for (const auto& edge : graph_.GetIncidentEdges(item.vertex)) {
+            const Weight candidate_weight = item.weight + edge.weight;
+            if (candidate_weight < scratch.GetWeight(edge.to)) {
+                scratch.stamps[edge.to] = scratch.epoch;
+                scratch.weights[edge.to] = candidate_weight;
+                scratch.prev_edges[edge.to] = edge.id;
+                heap.push_back({candidate_weight, edge.to});
+                std::push_heap(heap.begin(), heap.end(), heap_compare);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+std::shared_ptr<const typename DijkstraRouter<Weight>::ShortestPathTree>
+DijkstraRouter<Weight>::FindCachedTree(VertexId from) const {
+    std::lock_guard guard(cache_mutex_);
+    if (const auto it = cache_index_.find(from); it != cache_index_.end()) {
+        cache_list_.splice(cache_list_.begin(), cache_list_, it->second);
+        return it->second->second;
+    }
+    return nullptr;
+}
+
+template <typename Weight>
+std::shared_ptr<const typename DijkstraRouter<Weight>::ShortestPathTree>
+DijkstraRouter<Weight>::GetCachedTree(VertexId from) const {
+    if (auto tree = FindCachedTree(from)) {
+        return tree;
+    }
+
+    // The tree is built without holding the lock; if two threads race on the same
+    // source, the first tree stored wins
+    auto tree = BuildTree(from);
+
+    std::lock_guard guard(cache_mutex_);
+    if (const auto it = cache_index_.find(from); it != cache_index_.end()) {
+        return it->second->second;
+    }
+    cache_list_.emplace_front(from, tree);
+    cache_index_[from] = cache_list_.begin();
+    if (cache_list_.size() > cache_capacity_) {
+        cache_index_.erase(cache_list_.back().first);
+        cache_list_.pop_back();
+    }
+    return tree;
+}
+
+template <typename Weight>
+std::shared_ptr<const typename DijkstraRouter<Weight>::ShortestPathTree>
+DijkstraRouter<Weight>::BuildTree(VertexId from) const {
+    Scratch& scratch = GetScratch();
+    RunSearch(from, {nullptr, nullptr}, scratch);
+
+    const size_t vertex_count = graph_.GetVertexCount();
+    auto tree = std::make_shared<ShortestPathTree>();
+    tree->weights.resize(vertex_count);
+    tree->prev_edges.resize(vertex_count);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        const bool is_reached = scratch.IsReached(vertex);
+        tree->weights[vertex] = is_reached ? scratch.weights[vertex] : INFINITE_WEIGHT;
+        tree->prev_edges[vertex] = is_reached ? scratch.prev_edges[vertex] : NO_EDGE;
+    }
+    return tree;
+}
+
+template <typename Weight>
+template <typename PrevEdgeGetter>
+void DijkstraRouter<Weight>::CollectEdges(VertexId from, VertexId to, PrevEdgeGetter prev_edge,
+                                          std::vector<EdgeId>& edges) const {
+    edges.clear();
+    for (VertexId vertex = to; vertex != from;) {
+        const EdgeId edge_id = prev_edge(vertex);
+        edges.push_back(edge_id);
+        vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(edges.begin(), edges.end());
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(
+    VertexId from, VertexId to) const {
+    std::vector<EdgeId> edges;
+    const auto weight = BuildRoute(from, to, edges);
+    if (!weight) {
+        return std::nullopt;
+    }
+    return RouteInfo{*weight, std::move(edges)};
+}
+
+template <typename Weight>
+std::optional<Weight> DijkstraRouter<Weight>::BuildRoute(VertexId from, VertexId to,
+                                                         std::vector<EdgeId>& edges) const {
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    if (cache_capacity_ > 0) {
+        return BuildRouteFromTree(*GetCachedTree(from), from, to, edges);
+    }
+    return BuildRouteFromScratch(from, to, edges);
+}
+
+template <typename Weight>
+std::optional<Weight> DijkstraRouter<Weight>::BuildRouteUncached(VertexId from, VertexId to,
+                                                                 std::vector<EdgeId>& edges) const {
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    if (cache_capacity_ > 0) {
+        if (const auto tree = FindCachedTree(from)) {
+            return BuildRouteFromTree(*tree, from, to, edges);
+        }
+    }
+    return BuildRouteFromScratch(from, to, edges);
+}
+
+template <typename Weight>
+std::optional<Weight> DijkstraRouter<Weight>::BuildRouteFromTree(const ShortestPathTree& tree, VertexId from,
+                                                                 VertexId to, std::vector<EdgeId>& edges) const {
+    if (tree.weights[to] == INFINITE_WEIGHT) {
+        edges.clear();
+        return std::nullopt;
+    }
+    CollectEdges(from, to, [&tree](VertexId vertex) {
+        return tree.prev_edges[vertex];
+    }, edges);
+    return tree.weights[to];
+}
+
+template <typename Weight>
+std::optional<Weight> DijkstraRouter<Weight>::BuildRouteFromScratch(VertexId from, VertexId to,
+                                                                    std::vector<EdgeId>& edges) const {
+    Scratch& scratch = GetScratch();
+    RunSearch(from, {&to, &to + 1}, scratch);
+    if (!scratch.IsReached(to)) {
+        edges.clear();
+        return std::nullopt;
+    }
+    CollectEdges(from, to, [&scratch](VertexId vertex) {
+        return scratch.prev_edges[vertex];
+    }, edges);
+    return scratch.weights[to];
+}
+
+template <typename Weight>
+std::vector<std::optional<typename DijkstraRouter<Weight>::RouteInfo>> DijkstraRouter<Weight>::BuildRoutes(
+    VertexId from, const std::vector<VertexId>& targets) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || std::any_of(targets.begin(), targets.end(), [vertex_count](VertexId to) {
+            return to >= vertex_count;
+        })) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    std::vector<std::optional<RouteInfo>> routes(targets.size());
+    if (cache_capacity_ > 0) {
+        const auto tree = GetCachedTree(from);
+        for (size_t i = 0; i < targets.size(); ++i) {
+            if (tree->weights[targets[i]] != INFINITE_WEIGHT) {
+                routes[i].emplace().weight = tree->weights[targets[i]];
+                CollectEdges(from, targets[i], [&tree](VertexId vertex) {
+                    return tree->prev_edges[vertex];
+                }, routes[i]->edges);
+            }
+        }
+        return routes;
+    }
+
+    Scratch& scratch = GetScratch();
+    RunSearch(from, {targets.data(), targets.data() + targets.size()}, scratch);
+    for (size_t i = 0; i < targets.size(); ++i) {
+        if (scratch.IsReached(targets[i])) {
+            routes[i].emplace().weight = scratch.weights[targets[i]];
+            CollectEdges(from, targets[i], [&scratch](VertexId vertex) {
+                return scratch.prev_edges[vertex];
+            }, routes[i]->edges);
+        }
+    }
+    return routes;
+}
+
+template <typename Weight>
+void DijkstraRouter<Weight>::Repair(const std::vector<EdgeUpdate<Weight>>& updates) {
+    std::lock_guard guard(cache_mutex_);
+    for (auto it = cache_list_.begin(); it != cache_list_.end();) {
+        const ShortestPathTree& tree = *it->second;
+        const bool is_affected = IsTreeAffected(graph_, updates,
+            [&tree](VertexId vertex) {
+                return tree.weights[vertex];
+            },
+            [&tree](VertexId vertex) {
+                return tree.prev_edges[vertex] == NO_EDGE ? NO_TREE_EDGE : tree.prev_edges[vertex];
+            });
+        if (is_affected) {
+            cache_index_.erase(it->first);
+            it = cache_list_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+}  // namespace graph
@@ -0,0 +1,68 @@
+#include "distance_table.h"
+
+namespace transport {
+
+namespace {
+constexpr size_t MIN_CAPACITY = 16;
+} // namespace
+
+void DistanceTable::Reserve(size_t distance_count) {
+    // Each distance may take a slot for its mirror too
+    size_t capacity = MIN_CAPACITY;
+    while (capacity < 4 * (size_ + distance_count)) {
+        capacity *= 2;
+    }
+    if (capacity > slots_.size()) {
+        Rehash(capacity);
+    }
+}
+
+void DistanceTable::Set(StopId from, StopId to, int distance) {
+    Store(MakeKey(from, to), distance, true);
+    const uint64_t mirror_key = MakeKey(to, from);
+    if (!slots_[FindIndex(mirror_key)].is_explicit) {
+        Store(mirror_key, distance, false);
+    }
+}
+
+int DistanceTable::Get(StopId from, StopId to) const {
+    if (slots_.empty()) {
+        return 0;
+    }
+    // An empty slot holds distance 0
+    return slots_[FindIndex(MakeKey(from, to))].distance;
+}
+
+size_t DistanceTable::FindIndex(uint64_t key) const {
+    const size_t mask = slots_.size() - 1;
+    size_t index = Mix(key) & mask;
+    while (slots_[index].key != key && slots_[index].key != EMPTY_KEY) {
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+void DistanceTable::Rehash(size_t capacity) {
+    std::vector<Slot> old_slots(capacity);
+    old_slots.swap(slots_);
+    for (const Slot& slot : old_slots) {
+        if (slot.key != EMPTY_KEY) {
+            slots_[FindIndex(slot.key)] = slot;
+        }
+    }
+}
+
+void DistanceTable::Store(uint64_t key, int distance, bool is_explicit) {
+    if (2 * (size_ + 1) > slots_.size()) {
+        Rehash(slots_.empty() ? MIN_CAPACITY : 2 * slots_.size());
+    }
+    Slot& slot = slots_[FindIndex(key)];
+    if (slot.key == EMPTY_KEY) {
+        slot.key = key;
+        ++size_;
+    }
+    slot.distance = distance;
+    slot.is_explicit = is_explicit;
+}
+
+}  // namespace transport
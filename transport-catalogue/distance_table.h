@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace transport {
+
+// Road distances between stops keyed by their dense ids, in one open-addressing
+// table with linear probing. A distance set in one direction is also stored for
+// the opposite one until that is set explicitly, so a lookup is one probe
+// sequence, usually within a single cache line
+class DistanceTable {
+public:
+    using StopId = uint32_t;
+
+    // Room for distance_count more distances without rehashing
+    void Reserve(size_t distance_count);
+    void Set(StopId from, StopId to, int distance);
+    // 0 if no distance is known in either direction
+    int Get(StopId from, StopId to) const;
+
+private:
+    static constexpr uint64_t EMPTY_KEY = UINT64_MAX;
+
+    struct Slot {
+        uint64_t key = EMPTY_KEY;
+        int distance = 0;
+        bool is_explicit = false;  // set for this direction, not mirrored
+    };
+
+    static uint64_t MakeKey(StopId from, StopId to) {
+        return (static_cast<uint64_t>(from) << 32) | to;
+    }
+    // Finalizer of splitmix64: every key bit affects the low bits used as the index
+    static uint64_t Mix(uint64_t key) {
+        key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ull;
+        key = (key ^ (key >> 27)) * 0x94d049bb133111ebull;
+        return key ^ (key >> 31);
+    }
+
+    // Index of the slot holding the key, or of the empty slot it would go to;
+    // the table must not be empty
+    size_t FindIndex(uint64_t key) const;
+    void Rehash(size_t capacity);
+    void Store(uint64_t key, int distance, bool is_explicit);
+
+    std::vector<Slot> slots_;  // power of two in size, at most half full
+    size_t size_ = 0;
+};
+
+}  // namespace transport
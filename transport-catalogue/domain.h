@@ -13,24 +13,30 @@
 #pragma once
 
 #include "geo.h"
+#include "ranges.h"
 
+#include <cstdint>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <set>
 #include <unordered_map>
+#include <utility>
 
 namespace transport {
 
+struct Bus;
+
+// Stops and buses are stored by the catalogue: the names are views into its
+// string pool and the vectors are allocated from its arena, so they live as
+// long as the catalogue
 struct Stop {
-    std::string name;
+    std::string_view name;
     geo::Coordinates coordinates;
-    std::set<std::string> buses_by_stop;
-};
-
-struct Bus {
-    std::string number;
-    std::vector<const Stop*> stops;
-    bool is_circle;
+    // Buses through the stop, each once, sorted by number; kept by the catalogue
+    std::pmr::vector<const Bus*> buses_by_stop;
+    // Dense index in the catalogue, in the order the stops were added
+    uint32_t id;
 };
 
 struct BusStat {
@@ -40,4 +46,21 @@ struct BusStat {
     double curvature;
 };
 
+struct Bus {
+    std::string_view number;
+    std::pmr::vector<const Stop*> stops;
+    bool is_circle;
+    // Minutes after midnight the bus leaves its first stop, ascending; empty for a
+    // bus without a timetable. A trip runs the whole route, there and back for a
+    // non-circular bus
+    std::pmr::vector<double> departures;
+    // Computed by the catalogue when the bus is added or frozen, and again when a
+    // distance between its stops changes
+    BusStat stat;
+};
+
+// Contiguous views of (name, element) pairs in name order, as the catalogue keeps them
+using SortedBuses = ranges::Range<const std::pair<std::string_view, const Bus*>*>;
+using SortedStops = ranges::Range<const std::pair<std::string_view, const Stop*>*>;
+
 } // namespace transport
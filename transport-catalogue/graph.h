@@ -1,8 +1,11 @@
 #pragma once
 
 #include "ranges.h"
+#include "weight_traits.h"
 
 #include <cstdlib>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 namespace graph {
@@ -17,60 +20,415 @@ struct Edge {
     Weight weight;
 };
 
+// Outgoing edge as it is stored in the adjacency of its source vertex
+template <typename Weight>
+struct IncidentEdge {
+    VertexId to;
+    Weight weight;
+    EdgeId id;
+};
 
+// A changed edge and the edge before the change: its endpoints may differ when
+// the id was reused, and its weight is +inf for an edge that was just added.
+// Routers take a batch of them to repair their precomputed state
+template <typename Weight>
+struct EdgeUpdate {
+    EdgeId id;
+    Edge<Weight> old_edge;
+};
 
+// Edges are added into per-vertex incidence lists; Freeze() then compacts them
+// into CSR arrays (vertex offsets plus one contiguous array of outgoing edges
+// sorted by source vertex). Edges added to a frozen graph go to per-vertex
+// overflow lists, which GetIncidentEdges yields after the CSR block of the vertex,
+// so the graph need not be rebuilt for each addition; calling Freeze() again
+// folds them into the CSR arrays. Thaw() moves all edges back into the lists.
+// Edge weights can be changed in either state.
+//
+// A removed edge keeps its id, with +inf weight, until SetEdge() reuses it. In a
+// frozen graph a removed or moved edge leaves a dead CSR slot with +inf weight
+// behind, which GetIncidentEdges still yields until Freeze() folds it out.
+//
+// A frozen graph can also be built over CSR arrays it does not own, e.g. in a
+// memory-mapped file; they are copied only when the graph is first changed.
 template <typename Weight>
 class DirectedWeightedGraph {
 private:
-    using IncidenceList = std::vector<EdgeId>;
-    using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
+    using IncidenceList = std::vector<IncidentEdge<Weight>>;
+    using IncidentEdgesRange = ranges::ConcatRange<IncidentEdge<Weight>>;
 
 public:
+    // The arrays of a frozen graph without overflow edges: the edges by id, the
+    // vertex_count + 1 offsets of the blocks of incident_edges, and the outgoing
+    // edges grouped by source vertex
+    struct CsrView {
+        const Edge<Weight>* edges;
+        size_t edge_count;
+        const size_t* offsets;
+        const IncidentEdge<Weight>* incident_edges;
+    };
+
     DirectedWeightedGraph() = default;
     explicit DirectedWeightedGraph(size_t vertex_count);
+    // Frozen graph in which edge i gets id i; the same as adding the edges in order
+    // and calling Freeze(), without building the incidence lists first
+    DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>> edges);
+    // Frozen graph over the arrays of csr, as returned by GetCsrView(), which are
+    // neither copied nor owned: they must stay valid until the graph is destroyed
+    // or first changed
+    DirectedWeightedGraph(size_t vertex_count, CsrView csr);
     EdgeId AddEdge(const Edge<Weight>& edge);
+    void Freeze();
+    void Thaw();
+    void SetEdgeWeight(EdgeId edge_id, Weight weight);
+    // Replaces the edge under an existing id, possibly removed, endpoints included
+    void SetEdge(EdgeId edge_id, const Edge<Weight>& edge);
+    void RemoveEdge(EdgeId edge_id);
 
     size_t GetVertexCount() const;
     size_t GetEdgeCount() const;
+    bool IsFrozen() const;
+    // Edges added since the last Freeze() of a frozen graph
+    size_t GetOverflowEdgeCount() const;
+    size_t GetDeadSlotCount() const;
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
+    // Only for a frozen graph without overflow edges or dead slots
+    CsrView GetCsrView() const;
 
 private:
+    // Copies the borrowed arrays, before the first change
+    void Own();
+    bool IsRemoved(EdgeId edge_id) const {
+        return edge_id < is_removed_.size() && is_removed_[edge_id];
+    }
+    // The entry of the edge in the adjacency of edges_[edge_id].from, if any
+    IncidentEdge<Weight>* FindIncidentEdge(EdgeId edge_id);
+    // Take the edge out of the adjacency of edges_[edge_id].from and put it back
+    void DetachEdge(EdgeId edge_id);
+    void AttachEdge(EdgeId edge_id);
+
+    size_t vertex_count_ = 0;
+    bool is_frozen_ = false;
+    bool is_borrowed_ = false;
+    CsrView borrowed_{};  // the arrays in use while is_borrowed_
     std::vector<Edge<Weight>> edges_;
     std::vector<IncidenceList> incidence_lists_;
+    std::vector<size_t> offsets_;
+    std::vector<IncidentEdge<Weight>> incident_edges_;
+    std::vector<IncidenceList> overflow_lists_;  // empty until an edge is added while frozen
+    size_t overflow_edge_count_ = 0;
+    size_t dead_slot_count_ = 0;
+    std::vector<bool> is_removed_;  // by edge id, empty until an edge is removed
 };
 
 template <typename Weight>
 DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
-    : incidence_lists_(vertex_count) {
+    : vertex_count_(vertex_count)
+    , incidence_lists_(vertex_count) {
+}
+
+template <typename Weight>
+DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>> edges)
+    : vertex_count_(vertex_count)
+    , is_frozen_(true)
+    , edges_(std::move(edges))
+    , offsets_(vertex_count + 1, 0) {
+    for (const auto& edge : edges_) {
+        if (edge.from >= vertex_count_ || edge.to >= vertex_count_) {
+            throw std::out_of_range("Edge vertex is out of range");
+        }
+        ++offsets_[edge.from + 1];
+    }
+    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        offsets_[vertex + 1] += offsets_[vertex];
+    }
+    // Counting sort by source vertex keeps the edges of a vertex in id order
+    incident_edges_.resize(edges_.size());
+    std::vector<size_t> fill(offsets_.begin(), offsets_.end() - 1);
+    for (EdgeId id = 0; id < edges_.size(); ++id) {
+        const Edge<Weight>& edge = edges_[id];
+        incident_edges_[fill[edge.from]++] = {edge.to, edge.weight, id};
+    }
+}
+
+template <typename Weight>
+DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count, CsrView csr)
+    : vertex_count_(vertex_count)
+    , is_frozen_(true)
+    , is_borrowed_(true)
+    , borrowed_(csr) {
+    if (csr.offsets[0] != 0 || csr.offsets[vertex_count] != csr.edge_count) {
+        throw std::invalid_argument("CSR offsets do not match the edges");
+    }
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::Own() {
+    if (!is_borrowed_) {
+        return;
+    }
+    edges_.assign(borrowed_.edges, borrowed_.edges + borrowed_.edge_count);
+    offsets_.assign(borrowed_.offsets, borrowed_.offsets + vertex_count_ + 1);
+    incident_edges_.assign(borrowed_.incident_edges, borrowed_.incident_edges + borrowed_.edge_count);
+    is_removed_.clear();
+    is_borrowed_ = false;
+    borrowed_ = {};
 }
 
 template <typename Weight>
 EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
+    if (edge.from >= vertex_count_ || edge.to >= vertex_count_) {
+        throw std::out_of_range("Edge vertex is out of range");
+    }
+    Own();
+    const EdgeId id = edges_.size();
+    if (is_frozen_) {
+        if (overflow_lists_.empty()) {
+            overflow_lists_.resize(vertex_count_);
+        }
+        overflow_lists_[edge.from].push_back({edge.to, edge.weight, id});
+        ++overflow_edge_count_;
+    } else {
+        incidence_lists_[edge.from].push_back({edge.to, edge.weight, id});
+    }
     edges_.push_back(edge);
-    const EdgeId id = edges_.size() - 1;
-    incidence_lists_.at(edge.from).push_back(id);
+    if (!is_removed_.empty()) {
+        is_removed_.push_back(false);
+    }
     return id;
 }
 
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::Freeze() {
+    Own();
+    if (is_frozen_) {
+        if (overflow_edge_count_ > 0 || dead_slot_count_ > 0) {
+            // Through the lists, which keep the CSR block of a vertex before its
+            // overflow and drop the dead slots
+            Thaw();
+            Freeze();
+        }
+        return;
+    }
+    offsets_.assign(vertex_count_ + 1, 0);
+    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        offsets_[vertex + 1] = offsets_[vertex] + incidence_lists_[vertex].size();
+    }
+    incident_edges_.reserve(edges_.size());
+    for (const auto& incidence_list : incidence_lists_) {
+        incident_edges_.insert(incident_edges_.end(), incidence_list.begin(), incidence_list.end());
+    }
+    std::vector<IncidenceList>().swap(incidence_lists_);
+    is_frozen_ = true;
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::Thaw() {
+    if (!is_frozen_) {
+        return;
+    }
+    Own();
+    incidence_lists_.resize(vertex_count_);
+    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        if (dead_slot_count_ == 0) {
+            incidence_lists_[vertex].assign(incident_edges_.begin() + offsets_[vertex],
+                                            incident_edges_.begin() + offsets_[vertex + 1]);
+        } else {
+            for (size_t slot = offsets_[vertex]; slot < offsets_[vertex + 1]; ++slot) {
+                const EdgeId edge_id = incident_edges_[slot].id;
+                if (edges_[edge_id].from == vertex && !IsRemoved(edge_id)) {
+                    incidence_lists_[vertex].push_back(incident_edges_[slot]);
+                }
+            }
+        }
+        if (!overflow_lists_.empty()) {
+            incidence_lists_[vertex].insert(incidence_lists_[vertex].end(), overflow_lists_[vertex].begin(),
+                                            overflow_lists_[vertex].end());
+        }
+    }
+    std::vector<size_t>().swap(offsets_);
+    std::vector<IncidentEdge<Weight>>().swap(incident_edges_);
+    std::vector<IncidenceList>().swap(overflow_lists_);
+    overflow_edge_count_ = 0;
+    dead_slot_count_ = 0;
+    is_frozen_ = false;
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::SetEdgeWeight(EdgeId edge_id, Weight weight) {
+    Own();
+    Edge<Weight>& edge = edges_.at(edge_id);
+    if (IsRemoved(edge_id)) {
+        throw std::logic_error("Edge is removed");
+    }
+    edge.weight = weight;
+    FindIncidentEdge(edge_id)->weight = weight;
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::SetEdge(EdgeId edge_id, const Edge<Weight>& edge) {
+    if (edge.from >= vertex_count_ || edge.to >= vertex_count_) {
+        throw std::out_of_range("Edge vertex is out of range");
+    }
+    Own();
+    Edge<Weight>& old_edge = edges_.at(edge_id);
+    if (!IsRemoved(edge_id) && old_edge.from == edge.from) {
+        IncidentEdge<Weight>* incident_edge = FindIncidentEdge(edge_id);
+        incident_edge->to = edge.to;
+        incident_edge->weight = edge.weight;
+        old_edge = edge;
+        return;
+    }
+    if (IsRemoved(edge_id)) {
+        is_removed_[edge_id] = false;
+    } else {
+        DetachEdge(edge_id);
+    }
+    old_edge = edge;
+    AttachEdge(edge_id);
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::RemoveEdge(EdgeId edge_id) {
+    Own();
+    Edge<Weight>& edge = edges_.at(edge_id);
+    if (IsRemoved(edge_id)) {
+        return;
+    }
+    DetachEdge(edge_id);
+    edge.weight = WeightTraits<Weight>::INFINITE_WEIGHT;
+    is_removed_.resize(edges_.size());
+    is_removed_[edge_id] = true;
+}
+
+template <typename Weight>
+IncidentEdge<Weight>* DirectedWeightedGraph<Weight>::FindIncidentEdge(EdgeId edge_id) {
+    const VertexId from = edges_[edge_id].from;
+    IncidentEdge<Weight>* begin = is_frozen_ ? incident_edges_.data() + offsets_[from]
+                                             : incidence_lists_[from].data();
+    IncidentEdge<Weight>* end = is_frozen_ ? incident_edges_.data() + offsets_[from + 1]
+                                           : begin + incidence_lists_[from].size();
+    for (IncidentEdge<Weight>* incident_edge = begin; incident_edge != end; ++incident_edge) {
+        if (incident_edge->id == edge_id) {
+            return incident_edge;
+        }
+    }
+    if (!overflow_lists_.empty()) {
+        for (IncidentEdge<Weight>& incident_edge : overflow_lists_[from]) {
+            if (incident_edge.id == edge_id) {
+                return &incident_edge;
+            }
+        }
+    }
+    return nullptr;
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::DetachEdge(EdgeId edge_id) {
+    const VertexId from = edges_[edge_id].from;
+    IncidentEdge<Weight>* incident_edge = FindIncidentEdge(edge_id);
+    if (is_frozen_ && incident_edge >= incident_edges_.data() + offsets_[from]
+        && incident_edge < incident_edges_.data() + offsets_[from + 1]) {
+        // CSR slots do not move: this one stays dead until the next Freeze()
+        incident_edge->weight = WeightTraits<Weight>::INFINITE_WEIGHT;
+        ++dead_slot_count_;
+        return;
+    }
+    IncidenceList& list = is_frozen_ ? overflow_lists_[from] : incidence_lists_[from];
+    list.erase(list.begin() + (incident_edge - list.data()));
+    if (is_frozen_) {
+        --overflow_edge_count_;
+    }
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::AttachEdge(EdgeId edge_id) {
+    const Edge<Weight>& edge = edges_[edge_id];
+    if (!is_frozen_) {
+        incidence_lists_[edge.from].push_back({edge.to, edge.weight, edge_id});
+        return;
+    }
+    // Back to the dead slot the edge left, or into the overflow
+    if (IncidentEdge<Weight>* incident_edge = FindIncidentEdge(edge_id)) {
+        *incident_edge = {edge.to, edge.weight, edge_id};
+        --dead_slot_count_;
+        return;
+    }
+    if (overflow_lists_.empty()) {
+        overflow_lists_.resize(vertex_count_);
+    }
+    overflow_lists_[edge.from].push_back({edge.to, edge.weight, edge_id});
+    ++overflow_edge_count_;
+}
+
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-    return incidence_lists_.size();
+    return vertex_count_;
 }
 
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetEdgeCount() const {
-    return edges_.size();
+    return is_borrowed_ ? borrowed_.edge_count : edges_.size();
+}
+
+template <typename Weight>
+bool DirectedWeightedGraph<Weight>::IsFrozen() const {
+    return is_frozen_;
+}
+
+template <typename Weight>
+size_t DirectedWeightedGraph<Weight>::GetOverflowEdgeCount() const {
+    return overflow_edge_count_;
+}
+
+template <typename Weight>
+size_t DirectedWeightedGraph<Weight>::GetDeadSlotCount() const {
+    return dead_slot_count_;
 }
 
 template <typename Weight>
 const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
+    if (is_borrowed_) {
+        if (edge_id >= borrowed_.edge_count) {
+            throw std::out_of_range("Edge id is out of range");
+        }
+        return borrowed_.edges[edge_id];
+    }
     return edges_.at(edge_id);
 }
 
 template <typename Weight>
 typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
 DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-    return ranges::AsRange(incidence_lists_.at(vertex));
+    if (is_borrowed_) {
+        if (vertex >= vertex_count_) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        const IncidentEdge<Weight>* data = borrowed_.incident_edges;
+        return {data + borrowed_.offsets[vertex], data + borrowed_.offsets[vertex + 1], nullptr, nullptr};
+    }
+    if (is_frozen_) {
+        const IncidentEdge<Weight>* data = incident_edges_.data();
+        if (overflow_lists_.empty()) {
+            return {data + offsets_.at(vertex), data + offsets_[vertex + 1], nullptr, nullptr};
+        }
+        const auto& overflow_list = overflow_lists_.at(vertex);
+        return {data + offsets_[vertex], data + offsets_[vertex + 1],
+                overflow_list.data(), overflow_list.data() + overflow_list.size()};
+    }
+    const auto& incidence_list = incidence_lists_.at(vertex);
+    return {incidence_list.data(), incidence_list.data() + incidence_list.size(), nullptr, nullptr};
+}
+
+template <typename Weight>
+typename DirectedWeightedGraph<Weight>::CsrView DirectedWeightedGraph<Weight>::GetCsrView() const {
+    if (is_borrowed_) {
+        return borrowed_;
+    }
+    if (!is_frozen_ || overflow_edge_count_ > 0 || dead_slot_count_ > 0) {
+        throw std::logic_error("Only a frozen graph without overflow edges or dead slots has CSR arrays");
+    }
+    return {edges_.data(), edges_.size(), offsets_.data(), incident_edges_.data()};
 }
 }  // namespace graph
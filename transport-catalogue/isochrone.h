@@ -0,0 +1,80 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// One-to-all Dijkstra bounded by max_weight: calls visit(vertex, weight) for every
+// vertex reachable within max_weight, in the order of non-decreasing weight, and
+// never expands past the budget. Buffers are thread_local and stamped per search,
+// so the cost depends only on the reached part of the graph.
+template <typename Weight, typename Visitor>
+void VisitReachable(const DirectedWeightedGraph<Weight>& graph, VertexId from, Weight max_weight,
+                    Visitor visit) {
+    struct HeapItem {
+        Weight weight;
+        VertexId vertex;
+        bool operator>(const HeapItem& other) const {
+            return weight > other.weight;
+        }
+    };
+    struct Scratch {
+        std::vector<Weight> weights;
+        std::vector<uint32_t> stamps;
+        std::vector<HeapItem> heap;
+        uint32_t epoch = 0;
+    };
+    thread_local Scratch scratch;
+
+    const size_t vertex_count = graph.GetVertexCount();
+    if (scratch.stamps.size() < vertex_count) {
+        scratch.weights.resize(vertex_count);
+        scratch.stamps.resize(vertex_count, 0);
+    }
+    if (++scratch.epoch == 0) {
+        std::fill(scratch.stamps.begin(), scratch.stamps.end(), 0);
+        scratch.epoch = 1;
+    }
+    auto& heap = scratch.heap;
+    heap.clear();
+    const auto heap_compare = std::greater<HeapItem>{};
+
+    scratch.stamps[from] = scratch.epoch;
+    scratch.weights[from] = WeightTraits<Weight>::ZERO_WEIGHT;
+    heap.push_back({WeightTraits<Weight>::ZERO_WEIGHT, from});
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_compare);
+        const HeapItem item = heap.back();
+        heap.pop_back();
+        if (item.weight > scratch.weights[item.vertex]) {
+            continue;
+        }
+        visit(item.vertex, item.weight);
+        for (const auto& edge : graph.GetIncidentEdges(item.vertex)) {
+            // A removed edge keeps +inf weight, which a saturating sum would not
+            // take over a budget that is +inf itself
+            if (edge.weight == WeightTraits<Weight>::INFINITE_WEIGHT) {
+                continue;
+            }
+            const Weight candidate_weight = item.weight + edge.weight;
+            if (candidate_weight > max_weight) {
+                continue;
+            }
+            if (scratch.stamps[edge.to] != scratch.epoch || candidate_weight < scratch.weights[edge.to]) {
+                scratch.stamps[edge.to] = scratch.epoch;
+                scratch.weights[edge.to] = candidate_weight;
+                heap.push_back({candidate_weight, edge.to});
+                std::push_heap(heap.begin(), heap.end(), heap_compare);
+            }
+        }
+    }
+}
+
+}  // namespace graph
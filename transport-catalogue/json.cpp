@@ -382,4 +382,23 @@ void Print(const Document& doc, std::ostream& output) {
     PrintNode(doc.GetRoot(), ctx);
 }
 
+ArrayPrinter::ArrayPrinter(std::ostream& output)
+    : ctx_{ output } {
+    ctx_.out << "[\n"sv;
+}
+
+void ArrayPrinter::PrintElement(const Node& node) {
+    if (is_first_) is_first_ = false;
+    else ctx_.out << ",\n"s;
+    auto inner_ctx = ctx_.Indented();
+    inner_ctx.PrintIndent();
+    PrintNode(node, inner_ctx);
+}
+
+void ArrayPrinter::Finish() {
+    ctx_.out << "\n"s;
+    ctx_.PrintIndent();
+    ctx_.out << "]"sv;
+}
+
 }  // namespace json
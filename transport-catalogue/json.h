@@ -105,4 +105,17 @@ void PrintValue(const Value& value, const PrintContext& ctx) {
 void PrintNode(const Node& node, const PrintContext& ctx);
 void Print(const Document& doc, std::ostream& output);
 
+// Выводит массив поэлементно, по мере готовности элементов, в том же формате, что и Print
+class ArrayPrinter {
+public:
+    explicit ArrayPrinter(std::ostream& output);
+    void PrintElement(const Node& node);
+    // Закрывает массив
+    void Finish();
+
+private:
+    PrintContext ctx_;
+    bool is_first_ = true;
+};
+
 }  // namespace json
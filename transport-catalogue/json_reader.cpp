@@ -1,6 +1,9 @@
 #include "json_reader.h"
 #include "json_builder.h"
 
+#include <algorithm>
+#include <cmath>
+
 using namespace std::literals;
 
 namespace json_reader {
@@ -28,26 +31,96 @@ const json::Node& JsonReader::GetRoutingSettings() const {
 void JsonReader::ProcessRequests(const json::Node& stat_requests, 
                                transport::Catalogue& catalogue,
                                const renderer::MapRenderer& renderer,
-                               transport::Router& router) const {
-    json::Array result;
-    result.reserve(stat_requests.AsArray().size());
+                               const transport::LazyRouter& router) const {
+    const auto& requests = stat_requests.AsArray();
+    // Answers are printed in request order as soon as all earlier ones are ready
+    std::vector<std::optional<json::Node>> responses(requests.size());
+    std::vector<bool> is_answered(requests.size(), false);
+    json::ArrayPrinter printer(std::cout);
+    size_t printed_count = 0;
+    auto print_answered = [&] {
+        for (; printed_count < requests.size() && is_answered[printed_count]; ++printed_count) {
+            if (responses[printed_count]) {
+                printer.PrintElement(*responses[printed_count]);
+                responses[printed_count].reset();
+            }
+        }
+    };
 
-    for (const auto& request : stat_requests.AsArray()) {
-        const auto& request_map = request.AsMap();
+    // Requests that need no router are answered while it is being built
+    for (size_t i = 0; i < requests.size(); ++i) {
+        const auto& request_map = requests[i].AsMap();
         const auto& type = request_map.at("type").AsString();
+        if (IsRouterRequest(type)) continue;
         
         if (type == "Stop") {
-            result.push_back(PrintStop(request_map, catalogue).AsMap());
+            responses[i] = PrintStop(request_map, catalogue);
         } else if (type == "Bus") {
-            result.push_back(PrintRoute(request_map, catalogue).AsMap());
+            responses[i] = PrintRoute(request_map, catalogue);
         } else if (type == "Map") {
-            result.push_back(PrintMap(request_map, catalogue, renderer).AsMap());
-        } else if (type == "Route") {
-            result.push_back(PrintRouting(request_map, catalogue, router).AsMap());
+            responses[i] = PrintMap(request_map, catalogue, renderer);
+        }
+        is_answered[i] = true;
+        print_answered();
+    }
+
+    if (printed_count < requests.size()) {
+        std::cout.flush();
+        const transport::Router& built_router = router.Get();
+        const auto routes = FindRoutes(stat_requests, built_router);
+        for (size_t i = 0; i < requests.size(); ++i) {
+            const auto& request_map = requests[i].AsMap();
+            const auto& type = request_map.at("type").AsString();
+            if (type == "Route") {
+                responses[i] = PrintRouting(request_map, catalogue, routes.at(i));
+            } else if (type == "Isochrone") {
+                responses[i] = PrintIsochrone(request_map, built_router);
+            }
+            is_answered[i] = true;
+        }
+        print_answered();
+    }
+    printer.Finish();
+}
+
+std::unordered_map<size_t, std::optional<transport::RouteInfo>> JsonReader::FindRoutes(
+    const json::Node& stat_requests, const transport::Router& router) const {
+    // Route requests grouped by origin, in the order the origins first appear
+    std::vector<std::string_view> sources;
+    std::unordered_map<std::string_view, size_t> source_groups;
+    std::vector<std::vector<size_t>> group_requests;
+    std::unordered_map<size_t, std::optional<transport::RouteInfo>> routes;
+    const auto& requests = stat_requests.AsArray();
+    for (size_t i = 0; i < requests.size(); ++i) {
+        const auto& request_map = requests[i].AsMap();
+        if (request_map.at("type").AsString() != "Route") continue;
+
+        const std::string_view from = request_map.at("from").AsString();
+        if (request_map.count("departure_time")) {
+            routes.emplace(i, router.FindRoute(from, request_map.at("to").AsString(),
+                                               request_map.at("departure_time").AsDouble()));
+            continue;
         }
+        const auto [it, is_new] = source_groups.emplace(from, sources.size());
+        if (is_new) {
+            sources.push_back(from);
+            group_requests.emplace_back();
+        }
+        group_requests[it->second].push_back(i);
     }
 
-    json::Print(json::Document{result}, std::cout);
+    for (size_t group = 0; group < sources.size(); ++group) {
+        std::vector<std::string_view> targets;
+        targets.reserve(group_requests[group].size());
+        for (const size_t request : group_requests[group]) {
+            targets.push_back(requests[request].AsMap().at("to").AsString());
+        }
+        auto row = std::move(router.FindRouteMatrix({sources[group]}, targets).front());
+        for (size_t i = 0; i < targets.size(); ++i) {
+            routes.emplace(group_requests[group][i], std::move(row[i]));
+        }
+    }
+    return routes;
 }
 
 StopData JsonReader::FillStop(const json::Dict& request_map) const {
@@ -65,67 +138,182 @@ StopData JsonReader::FillStop(const json::Dict& request_map) const {
     return data;
 }
 
-RouteData JsonReader::FillRoute(const json::Dict& request_map, 
-                              transport::Catalogue& catalogue) const {
+RouteData JsonReader::FillRoute(const json::Dict& request_map) const {
     RouteData data;
     data.name = request_map.at("name").AsString();
     data.is_circular = request_map.at("is_roundtrip").AsBool();
 
     const auto& stops_array = request_map.at("stops").AsArray();
-    data.stops.reserve(stops_array.size());
+    data.stop_names.reserve(stops_array.size());
     
     for (const auto& stop_node : stops_array) {
-        data.stops.push_back(catalogue.FindStop(stop_node.AsString()));
+        data.stop_names.push_back(stop_node.AsString());
     }
+    data.departures = FillDepartures(request_map);
 
     return data;
 }
 
-void JsonReader::FillStopDistances(transport::Catalogue& catalogue) const {
-    const auto& arr = GetBaseRequests().AsArray();
-    for (const auto& request_stops : arr) {
-        const auto& request_map = request_stops.AsMap();
-        if (request_map.at("type").AsString() != "Stop") continue;
-
-        const auto stop_data = FillStop(request_map);
-        for (const auto& [to_name, dist] : stop_data.distances) {
-            auto from = catalogue.FindStop(stop_data.name);
-            auto to = catalogue.FindStop(to_name);
-            catalogue.SetDistance(from, to, dist);
+std::vector<double> JsonReader::FillDepartures(const json::Dict& request_map) const {
+    std::vector<double> departures;
+    if (request_map.count("departures")) {
+        for (const auto& departure : request_map.at("departures").AsArray()) {
+            departures.push_back(departure.AsDouble());
+        }
+    } else if (request_map.count("frequency")) {
+        const auto& frequency = request_map.at("frequency").AsMap();
+        const double first = frequency.at("first_departure").AsDouble();
+        const double last = frequency.at("last_departure").AsDouble();
+        const double interval = frequency.at("interval").AsDouble();
+        if (!(interval > 0.0) || last < first) {
+            throw std::logic_error("Invalid bus frequency");
+        }
+        // Counted rather than accumulated, so no departure drifts
+        const size_t count = static_cast<size_t>(std::floor((last - first) / interval + 1e-9)) + 1;
+        departures.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            departures.push_back(first + interval * static_cast<double>(i));
         }
     }
+    return departures;
 }
 
 void JsonReader::FillCatalogue(transport::Catalogue& catalogue) {
     const auto& arr = GetBaseRequests().AsArray();
-    
-    // First pass - add all stops
+
+    // First pass - count, so the catalogue allocates its indices once
+    size_t stop_count = 0;
+    size_t bus_count = 0;
+    size_t distance_count = 0;
     for (const auto& request : arr) {
         const auto& request_map = request.AsMap();
-        if (request_map.at("type").AsString() != "Stop") continue;
-
-        const auto stop_data = FillStop(request_map);
-        catalogue.AddStop(stop_data.name, stop_data.coordinates);
+        const auto& type = request_map.at("type").AsString();
+        if (type == "Stop") {
+            ++stop_count;
+            distance_count += request_map.at("road_distances").AsMap().size();
+        } else if (type == "Bus") {
+            ++bus_count;
+        }
     }
+    catalogue.Reserve(stop_count, bus_count, distance_count);
 
-    // Second pass - add distances between stops
-    FillStopDistances(catalogue);
-
-    // Third pass - add routes
+    // Second pass - load the records; the names they refer to are resolved by
+    // Freeze(), so stops, distances and routes may come in any order
     for (const auto& request : arr) {
         const auto& request_map = request.AsMap();
-        if (request_map.at("type").AsString() != "Bus") continue;
-
-        const auto route_data = FillRoute(request_map, catalogue);
-        catalogue.AddRoute(route_data.name, route_data.stops, route_data.is_circular);
+        const auto& type = request_map.at("type").AsString();
+        if (type == "Stop") {
+            const auto stop_data = FillStop(request_map);
+            catalogue.LoadStop(stop_data.name, stop_data.coordinates);
+            for (const auto& [to_name, dist] : stop_data.distances) {
+                catalogue.LoadDistance(stop_data.name, to_name, dist);
+            }
+        } else if (type == "Bus") {
+            auto route_data = FillRoute(request_map);
+            catalogue.LoadRoute(route_data.name, std::move(route_data.stop_names), route_data.is_circular,
+                                std::move(route_data.departures));
+        }
     }
+
+    catalogue.Freeze();
 }
 
 transport::Router JsonReader::FillRoutingSettings(const transport::Catalogue& catalogue) const {
+    return transport::Router(catalogue, ReadRoutingSettings());
+}
+
+transport::LazyRouter JsonReader::MakeLazyRouter(const transport::Catalogue& catalogue) const {
+    bool needs_router = false;
+    // Route requests with a departure_time are answered from the timetables alone
+    bool needs_graph = false;
+    if (GetStatRequests().IsArray()) {
+        for (const auto& request : GetStatRequests().AsArray()) {
+            const auto& request_map = request.AsMap();
+            if (IsRouterRequest(request_map.at("type").AsString())) {
+                needs_router = true;
+                needs_graph = needs_graph || request_map.at("type").AsString() != "Route"
+                              || request_map.count("departure_time") == 0;
+            }
+        }
+    }
+    if (needs_graph && ReadRoutingSettings().engine == transport::RouterEngine::CONNECTION_SCAN) {
+        throw std::logic_error("The connection_scan engine only answers Route requests with a departure_time");
+    }
+    const bool timetable_only = needs_router && !needs_graph;
+    return transport::LazyRouter(
+        needs_router ? transport::LazyRouter::Launch::BACKGROUND : transport::LazyRouter::Launch::DEFERRED,
+        [this, &catalogue, timetable_only] {
+            transport::RoutingSettings settings = ReadRoutingSettings();
+            if (timetable_only) {
+                settings.engine = transport::RouterEngine::CONNECTION_SCAN;
+            }
+            return std::make_shared<const transport::Router>(catalogue, settings);
+        });
+}
+
+bool JsonReader::IsRouterRequest(std::string_view type) {
+    return type == "Route" || type == "Isochrone";
+}
+
+transport::RoutingSettings JsonReader::ReadRoutingSettings() const {
     const auto& settings_map = GetRoutingSettings().AsMap();
-    int bus_wait_time = settings_map.at("bus_wait_time").AsInt();
-    double bus_velocity = settings_map.at("bus_velocity").AsDouble();
-    return transport::Router(catalogue, bus_wait_time, bus_velocity);
+    transport::RoutingSettings settings;
+    settings.bus_wait_time = settings_map.at("bus_wait_time").AsInt();
+    settings.bus_velocity = settings_map.at("bus_velocity").AsDouble();
+
+    // Optional keys, the defaults keep the precomputed all-pairs router
+    if (settings_map.count("routing_engine")) {
+        const auto& engine = settings_map.at("routing_engine").AsString();
+        if (engine == "all_pairs") {
+            settings.engine = transport::RouterEngine::ALL_PAIRS;
+        } else if (engine == "dijkstra") {
+            settings.engine = transport::RouterEngine::DIJKSTRA;
+        } else if (engine == "contraction_hierarchies") {
+            settings.engine = transport::RouterEngine::CONTRACTION_HIERARCHIES;
+        } else if (engine == "blocked_all_pairs") {
+            settings.engine = transport::RouterEngine::BLOCKED_ALL_PAIRS;
+        } else if (engine == "compact_all_pairs") {
+            settings.engine = transport::RouterEngine::COMPACT_ALL_PAIRS;
+        } else if (engine == "alt") {
+            settings.engine = transport::RouterEngine::ALT;
+        } else if (engine == "raptor") {
+            settings.engine = transport::RouterEngine::RAPTOR;
+        } else if (engine == "connection_scan") {
+            settings.engine = transport::RouterEngine::CONNECTION_SCAN;
+        } else {
+            throw std::logic_error("Invalid routing engine");
+        }
+    }
+    if (settings_map.count("vertex_order")) {
+        const auto& order = settings_map.at("vertex_order").AsString();
+        if (order == "name") {
+            settings.vertex_order = transport::VertexOrder::NAME;
+        } else if (order == "bfs") {
+            settings.vertex_order = transport::VertexOrder::BFS;
+        } else if (order == "rcm") {
+            settings.vertex_order = transport::VertexOrder::RCM;
+        } else if (order == "hilbert") {
+            settings.vertex_order = transport::VertexOrder::HILBERT;
+        } else {
+            throw std::logic_error("Invalid vertex order");
+        }
+    }
+    if (settings_map.count("tree_cache_size")) {
+        settings.tree_cache_size = static_cast<size_t>(settings_map.at("tree_cache_size").AsInt());
+    }
+    if (settings_map.count("thread_count")) {
+        settings.thread_count = static_cast<size_t>(settings_map.at("thread_count").AsInt());
+    }
+    if (settings_map.count("landmark_count")) {
+        settings.landmark_count = static_cast<size_t>(settings_map.at("landmark_count").AsInt());
+    }
+    if (settings_map.count("route_cache_size")) {
+        settings.route_cache_size = static_cast<size_t>(settings_map.at("route_cache_size").AsInt());
+    }
+    if (settings_map.count("index_file")) {
+        settings.index_file = settings_map.at("index_file").AsString();
+    }
+    return settings;
 }
 
 std::optional<transport::BusStat> JsonReader::GetBusStat(
@@ -135,40 +323,17 @@ std::optional<transport::BusStat> JsonReader::GetBusStat(
     const transport::Bus* bus = catalogue.FindRoute(bus_number);
     if (!bus) return std::nullopt;
 
-    transport::BusStat stat;
-    stat.stops_count = bus->is_circle ? bus->stops.size() 
-                                     : bus->stops.size() * 2 - 1;
-    stat.unique_stops_count = catalogue.UniqueStopsCount(bus_number);
-
-    double geographic_length = 0.0;
-    stat.route_length = 0;
-
-    for (size_t i = 0; i < bus->stops.size() - 1; ++i) {
-        const auto from = bus->stops[i];
-        const auto to = bus->stops[i + 1];
-        const double direct_distance = geo::ComputeDistance(
-            from->coordinates, to->coordinates);
-
-        if (bus->is_circle) {
-            stat.route_length += catalogue.GetDistance(from, to);
-            geographic_length += direct_distance;
-        } else {
-            stat.route_length += catalogue.GetDistance(from, to) + 
-                               catalogue.GetDistance(to, from);
-            geographic_length += direct_distance * 2;
-        }
-    }
-
-    stat.curvature = stat.route_length / geographic_length;
-    return stat;
+    return bus->stat;
 }
 
-const std::set<std::string> JsonReader::GetBusesByStop(
+ranges::Range<const transport::Bus* const*> JsonReader::GetBusesByStop(
     const transport::Catalogue& catalogue,
     std::string_view stop_name) const {
     
     const auto* stop = catalogue.FindStop(stop_name);
-    return stop ? stop->buses_by_stop : std::set<std::string>{};
+    if (!stop) return {nullptr, nullptr};
+    const auto& buses = stop->buses_by_stop;
+    return {buses.data(), buses.data() + buses.size()};
 }
 
 bool JsonReader::IsBusNumber(const transport::Catalogue& catalogue,
@@ -183,7 +348,7 @@ bool JsonReader::IsStopName(const transport::Catalogue& catalogue,
 
 svg::Document JsonReader::RenderMap(const transport::Catalogue& catalogue,
                                   const renderer::MapRenderer& renderer) const {
-    return renderer.GetSVG(catalogue.GetSortedAllBuses());
+    return renderer.GetSVG(catalogue.GetSortedAllBuses(), catalogue.GetSortedAllStops());
 }
 
 const json::Node JsonReader::PrintRoute(const json::Dict& request_map,
@@ -220,9 +385,11 @@ const json::Node JsonReader::PrintStop(const json::Dict& request_map,
         builder.Key("error_message").Value("not found"s);
     } else {
         json::Array buses;
-        const auto buses_set = GetBusesByStop(catalogue, stop_name);
-        buses.reserve(buses_set.size());
-        buses.insert(buses.end(), buses_set.begin(), buses_set.end());
+        const auto stop_buses = GetBusesByStop(catalogue, stop_name);
+        buses.reserve(stop_buses.end() - stop_buses.begin());
+        for (const transport::Bus* bus : stop_buses) {
+            buses.emplace_back(std::string(bus->number));
+        }
         builder.Key("buses").Value(std::move(buses));
     }
 
@@ -248,7 +415,7 @@ const json::Node JsonReader::PrintMap(const json::Dict& request_map,
 
 const json::Node JsonReader::PrintRouting(const json::Dict& request_map,
                                         transport::Catalogue& catalogue,
-                                        transport::Router& router) const {
+                                        const std::optional<transport::RouteInfo>& route_info) const {
     json::Builder builder;
     builder.StartDict();
     
@@ -263,7 +430,6 @@ const json::Node JsonReader::PrintRouting(const json::Dict& request_map,
     if (!from_stop || !to_stop) {
         builder.Key("error_message").Value("not found"s);
     } else {
-        auto route_info = router.FindRoute(from, to);
         if (!route_info) {
             builder.Key("error_message").Value("not found"s);
         } else {
@@ -280,14 +446,14 @@ const json::Node JsonReader::PrintRouting(const json::Dict& request_map,
                     // Wait activity
                     builder.StartDict()
                         .Key("type").Value("Wait")
-                        .Key("stop_name").Value(edge.stop_name)
+                        .Key("stop_name").Value(std::string(edge.stop_name))
                         .Key("time").Value(round_time(edge.time))
                         .EndDict();
                 } else {
                     // Bus activity
                     builder.StartDict()
                         .Key("type").Value("Bus")
-                        .Key("bus").Value(edge.bus_name)
+                        .Key("bus").Value(std::string(edge.bus_name))
                         .Key("span_count").Value(edge.span_count)
                         .Key("time").Value(round_time(edge.time))
                         .EndDict();
@@ -301,6 +467,31 @@ const json::Node JsonReader::PrintRouting(const json::Dict& request_map,
     return builder.Build();
 }
 
+const json::Node JsonReader::PrintIsochrone(const json::Dict& request_map,
+                                          const transport::Router& router) const {
+    json::Builder builder;
+    builder.StartDict();
+    builder.Key("request_id").Value(request_map.at("id").AsInt());
+
+    const auto reachable = router.FindReachableStops(request_map.at("from").AsString(),
+                                                     request_map.at("max_time").AsDouble());
+    if (!reachable) {
+        builder.Key("error_message").Value("not found"s);
+    } else {
+        builder.Key("items").StartArray();
+        for (const auto& stop : *reachable) {
+            builder.StartDict()
+                .Key("stop_name").Value(std::string(stop.stop_name))
+                .Key("time").Value(std::round(stop.time * 1e6) / 1e6)
+                .EndDict();
+        }
+        builder.EndArray();
+    }
+
+    builder.EndDict();
+    return builder.Build();
+}
+
 renderer::MapRenderer JsonReader::FillRenderSettings(const json::Dict& request_map) const {
     renderer::RenderSettings settings;
     
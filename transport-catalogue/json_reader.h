@@ -5,6 +5,7 @@
 #include "transport_catalogue.h"
 #include "map_renderer.h"
 #include "transport_router.h"  // Add this include
+#include "ranges.h"
 
 #include <iostream>
 #include <sstream>
@@ -19,8 +20,9 @@ struct StopData {
 
 struct RouteData {
     std::string_view name;
-    std::vector<const transport::Stop*> stops;
+    std::vector<std::string_view> stop_names;
     bool is_circular;
+    std::vector<double> departures;
 };
 
 class JsonReader {
@@ -34,25 +36,40 @@ public:
     const json::Node& GetRenderSettings() const;
     const json::Node& GetRoutingSettings() const;  // Add this method
 
+    // Streams the answers; only Route and Isochrone requests wait for the router
     void ProcessRequests(const json::Node& stat_requests, 
                         transport::Catalogue& catalogue, 
                         const renderer::MapRenderer& renderer,
-                        transport::Router& router) const;  // Add router parameter
+                        const transport::LazyRouter& router) const;
 
+    // Bulk-loads the base requests and freezes the catalogue
     void FillCatalogue(transport::Catalogue& catalogue);
     renderer::MapRenderer FillRenderSettings(const json::Dict& request_map) const;
     transport::Router FillRoutingSettings(const transport::Catalogue& catalogue) const;
+    transport::RoutingSettings ReadRoutingSettings() const;
+    // Builds the router in the background if any stat request needs it, otherwise
+    // only on first use. If all of them are Route requests with a departure_time,
+    // only the timetables are built, no graph. Throws if the routing_engine is
+    // connection_scan and other router requests need the graph. The reader and the
+    // catalogue must outlive the result
+    transport::LazyRouter MakeLazyRouter(const transport::Catalogue& catalogue) const;
 
 private:
     json::Document input_;
     json::Node dummy_ = nullptr;
 
+    static bool IsRouterRequest(std::string_view type);
+
     StopData FillStop(const json::Dict& request_map) const;
-    void FillStopDistances(transport::Catalogue& catalogue) const;
-    RouteData FillRoute(const json::Dict& request_map, transport::Catalogue& catalogue) const;
+    RouteData FillRoute(const json::Dict& request_map) const;
+    // Timetable of a Bus request: "departures", a list of minutes after midnight, or
+    // "frequency" with "first_departure", "last_departure" and "interval" in minutes
+    std::vector<double> FillDepartures(const json::Dict& request_map) const;
 
     std::optional<transport::BusStat> GetBusStat(const transport::Catalogue& catalogue, const std::string_view bus_number) const;
-    const std::set<std::string> GetBusesByStop(const transport::Catalogue& catalogue, std::string_view stop_name) const;
+    // A view of the buses kept by the stop, empty for an unknown stop
+    ranges::Range<const transport::Bus* const*> GetBusesByStop(const transport::Catalogue& catalogue,
+                                                               std::string_view stop_name) const;
     bool IsBusNumber(const transport::Catalogue& catalogue, const std::string_view bus_number) const;
     bool IsStopName(const transport::Catalogue& catalogue, const std::string_view stop_name) const;
     svg::Document RenderMap(const transport::Catalogue& catalogue, const renderer::MapRenderer& renderer) const;
@@ -60,7 +77,12 @@ private:
     const json::Node PrintRoute(const json::Dict& request_map, transport::Catalogue& catalogue) const;
     const json::Node PrintStop(const json::Dict& request_map, transport::Catalogue& catalogue) const;
     const json::Node PrintMap(const json::Dict& request_map, const transport::Catalogue& catalogue, const renderer::MapRenderer& renderer) const;
-    const json::Node PrintRouting(const json::Dict& request_map, transport::Catalogue& catalogue, transport::Router& router) const;  // Add this method
+    const json::Node PrintRouting(const json::Dict& request_map, transport::Catalogue& catalogue, const std::optional<transport::RouteInfo>& route_info) const;
+    const json::Node PrintIsochrone(const json::Dict& request_map, const transport::Router& router) const;
+
+    // Answers all Route requests with one search per distinct origin, keyed by request position.
+    // Requests with a departure_time are answered one by one from the timetables
+    std::unordered_map<size_t, std::optional<transport::RouteInfo>> FindRoutes(const json::Node& stat_requests, const transport::Router& router) const;
 };
 
 } // namespace json_reader
@@ -13,9 +13,9 @@ int main() {
     // 2. Configure renderer
     const auto renderer = json_doc.FillRenderSettings(json_doc.GetRenderSettings().AsMap());
     
-    // 3. Configure router
-    transport::Router router = json_doc.FillRoutingSettings(catalogue);
-   
+    // 3. Configure router: built in the background, only if a request needs it
+    const transport::LazyRouter router = json_doc.MakeLazyRouter(catalogue);
+
     
     // 4. Process requests
     const auto& stat_requests = json_doc.GetStatRequests();
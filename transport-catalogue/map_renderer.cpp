@@ -12,7 +12,7 @@ bool IsZero(double value) {
     return std::abs(value) < EPSILON;
 }
 
-std::vector<svg::Polyline> MapRenderer::GetRouteLines(const std::map<std::string_view, const transport::Bus*>& buses, const SphereProjector& sp) const {
+std::vector<svg::Polyline> MapRenderer::GetRouteLines(transport::SortedBuses buses, const SphereProjector& sp) const {
     std::vector<svg::Polyline> result;
     size_t color_num = 0;
     for (const auto& [bus_number, bus] : buses) {
@@ -38,7 +38,7 @@ std::vector<svg::Polyline> MapRenderer::GetRouteLines(const std::map<std::string
     return result;
 }
 
-std::vector<svg::Text> MapRenderer::GetBusLabel(const std::map<std::string_view, const transport::Bus*>& buses, const SphereProjector& sp) const {
+std::vector<svg::Text> MapRenderer::GetBusLabel(transport::SortedBuses buses, const SphereProjector& sp) const {
     std::vector<svg::Text> result;
     size_t color_num = 0;
     for (const auto& [bus_number, bus] : buses) {
@@ -50,7 +50,7 @@ std::vector<svg::Text> MapRenderer::GetBusLabel(const std::map<std::string_view,
         text.SetFontSize(render_settings_.bus_label_font_size);
         text.SetFontFamily("Verdana");
         text.SetFontWeight("bold");
-        text.SetData(bus->number);
+        text.SetData(std::string(bus->number));
         text.SetFillColor(render_settings_.color_palette[color_num]);
         if (color_num < (render_settings_.color_palette.size() - 1)) ++color_num;
         else color_num = 0;
@@ -60,7 +60,7 @@ std::vector<svg::Text> MapRenderer::GetBusLabel(const std::map<std::string_view,
         underlayer.SetFontSize(render_settings_.bus_label_font_size);
         underlayer.SetFontFamily("Verdana");
         underlayer.SetFontWeight("bold");
-        underlayer.SetData(bus->number);
+        underlayer.SetData(std::string(bus->number));
         underlayer.SetFillColor(render_settings_.underlayer_color);
         underlayer.SetStrokeColor(render_settings_.underlayer_color);
         underlayer.SetStrokeWidth(render_settings_.underlayer_width);
@@ -84,7 +84,7 @@ std::vector<svg::Text> MapRenderer::GetBusLabel(const std::map<std::string_view,
     return result;
 }
 
-std::vector<svg::Circle> MapRenderer::GetStopsSymbols(const std::map<std::string_view, const transport::Stop*>& stops, const SphereProjector& sp) const {
+std::vector<svg::Circle> MapRenderer::GetStopsSymbols(transport::SortedStops stops, const SphereProjector& sp) const {
     std::vector<svg::Circle> result;
     for (const auto& [stop_name, stop] : stops) {
         svg::Circle symbol;
@@ -98,7 +98,7 @@ std::vector<svg::Circle> MapRenderer::GetStopsSymbols(const std::map<std::string
     return result;
 }
 
-std::vector<svg::Text> MapRenderer::GetStopsLabels(const std::map<std::string_view, const transport::Stop*>& stops, const SphereProjector& sp) const {
+std::vector<svg::Text> MapRenderer::GetStopsLabels(transport::SortedStops stops, const SphereProjector& sp) const {
     std::vector<svg::Text> result;
     svg::Text text;
     svg::Text underlayer;
@@ -107,14 +107,14 @@ std::vector<svg::Text> MapRenderer::GetStopsLabels(const std::map<std::string_vi
         text.SetOffset(render_settings_.stop_label_offset);
         text.SetFontSize(render_settings_.stop_label_font_size);
         text.SetFontFamily("Verdana");
-        text.SetData(stop->name);
+        text.SetData(std::string(stop->name));
         text.SetFillColor("black");
         
         underlayer.SetPosition(sp(stop->coordinates));
         underlayer.SetOffset(render_settings_.stop_label_offset);
         underlayer.SetFontSize(render_settings_.stop_label_font_size);
         underlayer.SetFontFamily("Verdana");
-        underlayer.SetData(stop->name);
+        underlayer.SetData(std::string(stop->name));
         underlayer.SetFillColor(render_settings_.underlayer_color);
         underlayer.SetStrokeColor(render_settings_.underlayer_color);
         underlayer.SetStrokeWidth(render_settings_.underlayer_width);
@@ -128,18 +128,17 @@ std::vector<svg::Text> MapRenderer::GetStopsLabels(const std::map<std::string_vi
     return result;
 }
 
-svg::Document MapRenderer::GetSVG(const std::map<std::string_view, const transport::Bus*>& buses) const {
+svg::Document MapRenderer::GetSVG(transport::SortedBuses buses, transport::SortedStops stops) const {
     svg::Document result;
+    std::vector<std::pair<std::string_view, const transport::Stop*>> route_stops;
     std::vector<geo::Coordinates> route_stops_coord;
-    std::map<std::string_view, const transport::Stop*> all_stops;
     
-    for (const auto& [bus_number, bus] : buses) {
-        if (bus->stops.empty()) continue;
-        for (const auto& stop : bus->stops) {
-            route_stops_coord.push_back(stop->coordinates);
-            all_stops[stop->name] = stop;
-        }
+    for (const auto& [stop_name, stop] : stops) {
+        if (stop->buses_by_stop.empty()) continue;
+        route_stops.emplace_back(stop_name, stop);
+        route_stops_coord.push_back(stop->coordinates);
     }
+    const transport::SortedStops all_stops{ route_stops.data(), route_stops.data() + route_stops.size() };
     SphereProjector sp(route_stops_coord.begin(), route_stops_coord.end(), render_settings_.width, render_settings_.height, render_settings_.padding);
     
     for (const auto& line : GetRouteLines(buses, sp)) result.Add(line);
@@ -106,12 +106,13 @@ public:
         : render_settings_(render_settings)
     {}
     
-    std::vector<svg::Polyline> GetRouteLines(const std::map<std::string_view, const transport::Bus*>& buses, const SphereProjector& sp) const;
-    std::vector<svg::Text> GetBusLabel(const std::map<std::string_view, const transport::Bus*>& buses, const SphereProjector& sp) const;
-    std::vector<svg::Circle> GetStopsSymbols(const std::map<std::string_view, const transport::Stop*>& stops, const SphereProjector& sp) const;
-    std::vector<svg::Text> GetStopsLabels(const std::map<std::string_view, const transport::Stop*>& stops, const SphereProjector& sp) const;
+    std::vector<svg::Polyline> GetRouteLines(transport::SortedBuses buses, const SphereProjector& sp) const;
+    std::vector<svg::Text> GetBusLabel(transport::SortedBuses buses, const SphereProjector& sp) const;
+    std::vector<svg::Circle> GetStopsSymbols(transport::SortedStops stops, const SphereProjector& sp) const;
+    std::vector<svg::Text> GetStopsLabels(transport::SortedStops stops, const SphereProjector& sp) const;
     
-    svg::Document GetSVG(const std::map<std::string_view, const transport::Bus*>& buses) const;
+    // Draws the buses and those of the stops some bus goes through
+    svg::Document GetSVG(transport::SortedBuses buses, transport::SortedStops stops) const;
     
 private:
     const RenderSettings render_settings_;
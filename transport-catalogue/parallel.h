@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+// thread_count == 0 means std::thread::hardware_concurrency()
+inline size_t GetThreadCount(size_t thread_count) {
+    return thread_count ? thread_count : std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+// Runs worker(0) ... worker(worker_count - 1) at the same time, worker(0) on the
+// calling thread, and returns when all of them are done
+template <typename Worker>
+void RunWorkers(size_t worker_count, Worker worker) {
+    std::vector<std::thread> threads;
+    threads.reserve(worker_count > 1 ? worker_count - 1 : 0);
+    for (size_t i = 1; i < worker_count; ++i) {
+        threads.emplace_back([&worker, i] {
+            worker(i);
+        });
+    }
+    worker(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Runs task(0) ... task(task_count - 1) on up to thread_count threads, the calling
+// one included; thread_count == 0 means std::thread::hardware_concurrency()
+template <typename Task>
+void Run(size_t thread_count, size_t task_count, Task task) {
+    const size_t worker_count = std::min(GetThreadCount(thread_count), task_count);
+    if (worker_count <= 1) {
+        for (size_t i = 0; i < task_count; ++i) {
+            task(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next_task = 0;
+    RunWorkers(worker_count, [&next_task, &task, task_count](size_t) {
+        for (size_t i = next_task++; i < task_count; i = next_task++) {
+            task(i);
+        }
+    });
+}
+
+// Reusable barrier for a fixed number of threads: ArriveAndWait returns once all
+// of them have arrived, and the next phase may start right away
+class Barrier {
+public:
+    explicit Barrier(size_t thread_count)
+        : thread_count_(thread_count) {
+    }
+
+    void ArriveAndWait() {
+        std::unique_lock lock(mutex_);
+        const size_t generation = generation_;
+        if (++arrived_count_ == thread_count_) {
+            arrived_count_ = 0;
+            ++generation_;
+            lock.unlock();
+            condition_.notify_all();
+            return;
+        }
+        condition_.wait(lock, [this, generation] {
+            return generation_ != generation;
+        });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    const size_t thread_count_;
+    size_t arrived_count_ = 0;
+    size_t generation_ = 0;
+};
+
+}  // namespace parallel
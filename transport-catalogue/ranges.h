@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <iterator>
 #include <string_view>
 #include <unordered_map>
@@ -22,12 +23,101 @@ public:
     It end() const {
         return end_;
     }
+    size_t size() const {
+        return static_cast<size_t>(std::distance(begin_, end_));
+    }
+    bool empty() const {
+        return begin_ == end_;
+    }
 
 private:
     It begin_;
     It end_;
 };
 
+// Two arrays iterated one after the other, e.g. a contiguous block and its
+// overflow. Either may be empty
+template <typename T>
+class ConcatRange {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        Iterator(const T* current, const T* segment_end, const T* next_begin, const T* next_end)
+            : current_(current)
+            , segment_end_(segment_end)
+            , next_begin_(next_begin)
+            , next_end_(next_end) {
+        }
+        reference operator*() const {
+            return *current_;
+        }
+        pointer operator->() const {
+            return current_;
+        }
+        Iterator& operator++() {
+            if (++current_ == segment_end_ && segment_end_ != next_end_) {
+                current_ = next_begin_;
+                segment_end_ = next_end_;
+            }
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+        // The end of the second array is the end of the range
+        bool operator==(const Iterator& other) const {
+            return current_ == other.current_;
+        }
+        bool operator!=(const Iterator& other) const {
+            return current_ != other.current_;
+        }
+
+    private:
+        const T* current_;
+        const T* segment_end_;
+        const T* next_begin_;
+        const T* next_end_;
+    };
+
+    using ValueType = T;
+
+    ConcatRange(const T* first_begin, const T* first_end, const T* second_begin, const T* second_end)
+        : first_begin_(first_begin)
+        , first_end_(first_end)
+        , second_begin_(second_begin)
+        , second_end_(second_end) {
+    }
+    Iterator begin() const {
+        if (first_begin_ == first_end_) {
+            return {second_begin_, second_end_, second_end_, second_end_};
+        }
+        return {first_begin_, first_end_, second_begin_, second_end_};
+    }
+    Iterator end() const {
+        return {second_end_, second_end_, second_end_, second_end_};
+    }
+    size_t size() const {
+        return static_cast<size_t>((first_end_ - first_begin_) + (second_end_ - second_begin_));
+    }
+    bool empty() const {
+        return first_begin_ == first_end_ && second_begin_ == second_end_;
+    }
+
+private:
+    const T* first_begin_;
+    const T* first_end_;
+    const T* second_begin_;
+    const T* second_end_;
+};
+
 template <typename C>
 auto AsRange(const C& container) {
     return Range{container.begin(), container.end()};
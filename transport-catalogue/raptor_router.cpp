@@ -0,0 +1,343 @@
+#include "raptor_router.h"
+#include "route_units.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace transport {
+
+namespace {
+constexpr double INFINITE_TIME = std::numeric_limits<double>::infinity();
+constexpr uint32_t NO_POSITION = std::numeric_limits<uint32_t>::max();
+// Inactive patterns are dropped once they hold more than this fraction of the
+// pattern stops
+constexpr size_t COMPACTION_DIVISOR = 8;
+} // namespace
+
+RaptorRouter::RaptorRouter(const Catalogue& catalogue, int bus_wait_time, double bus_velocity)
+    : bus_wait_time_(bus_wait_time)
+    , velocity_m_per_min_(ToMetersPerMinute(bus_velocity)) {
+    for (const auto& [stop_name, stop] : catalogue.GetSortedAllStops()) {
+        stop_indices_[stop->name] = static_cast<StopIndex>(stops_.size());
+        stops_.push_back(stop);
+    }
+
+    for (const auto& [bus_name, bus] : catalogue.GetSortedAllBuses()) {
+        AddPatterns(bus, catalogue);
+    }
+    BuildVisits();
+}
+
+void RaptorRouter::AddBus(const Catalogue& catalogue, const Bus* bus) {
+    // A changed bus with as many stops keeps its patterns, rewritten in place
+    std::vector<Pattern*> bus_patterns;
+    for (Pattern& pattern : patterns_) {
+        if (pattern.is_active && pattern.bus->number == bus->number && pattern.length == bus->stops.size()) {
+            bus_patterns.push_back(&pattern);
+        }
+    }
+    const size_t pattern_count = bus->stops.size() < 2 ? 0 : bus->is_circle ? 1 : 2;
+    if (pattern_count > 0 && bus_patterns.size() == pattern_count) {
+        bus_patterns[0]->bus = bus;
+        WritePattern(*bus_patterns[0], { bus->stops.begin(), bus->stops.end() }, catalogue);
+        if (!bus->is_circle) {
+            bus_patterns[1]->bus = bus;
+            WritePattern(*bus_patterns[1], { bus->stops.rbegin(), bus->stops.rend() }, catalogue);
+        }
+    } else {
+        DeactivatePatterns(bus->number);
+        AddPatterns(bus, catalogue);
+        if (inactive_stop_count_ * COMPACTION_DIVISOR > pattern_stops_.size()) {
+            CompactPatterns();
+        }
+    }
+    BuildVisits();
+}
+
+void RaptorRouter::RemoveBus(std::string_view bus_name) {
+    DeactivatePatterns(bus_name);
+    if (inactive_stop_count_ * COMPACTION_DIVISOR > pattern_stops_.size()) {
+        CompactPatterns();
+        BuildVisits();
+    }
+}
+
+void RaptorRouter::DeactivatePatterns(std::string_view bus_name) {
+    for (Pattern& pattern : patterns_) {
+        if (pattern.is_active && pattern.bus->number == bus_name) {
+            pattern.is_active = false;
+            inactive_stop_count_ += pattern.length;
+        }
+    }
+}
+
+void RaptorRouter::CompactPatterns() {
+    size_t active_count = 0;
+    size_t stop_count = 0;
+    for (size_t i = 0; i < patterns_.size(); ++i) {
+        const Pattern pattern = patterns_[i];
+        if (!pattern.is_active) {
+            continue;
+        }
+        // Moves left only, so the stops not moved yet are not overwritten
+        std::copy(pattern_stops_.begin() + pattern.first, pattern_stops_.begin() + pattern.first + pattern.length,
+                  pattern_stops_.begin() + stop_count);
+        std::copy(pattern_distances_.begin() + pattern.first,
+                  pattern_distances_.begin() + pattern.first + pattern.length,
+                  pattern_distances_.begin() + stop_count);
+        patterns_[active_count++] = { pattern.bus, stop_count, pattern.length };
+        stop_count += pattern.length;
+    }
+    patterns_.resize(active_count);
+    pattern_stops_.resize(stop_count);
+    pattern_distances_.resize(stop_count);
+    inactive_stop_count_ = 0;
+}
+
+void RaptorRouter::UpdateBusDistances(const Catalogue& catalogue, std::string_view bus_name) {
+    for (const Pattern& pattern : patterns_) {
+        if (pattern.is_active && pattern.bus->number == bus_name) {
+            ComputePatternDistances(pattern, catalogue);
+        }
+    }
+}
+
+void RaptorRouter::AddPatterns(const Bus* bus, const Catalogue& catalogue) {
+    if (bus->stops.size() < 2) return;
+    AddPattern(bus, { bus->stops.begin(), bus->stops.end() }, catalogue);
+    if (!bus->is_circle) {
+        AddPattern(bus, { bus->stops.rbegin(), bus->stops.rend() }, catalogue);
+    }
+}
+
+void RaptorRouter::BuildVisits() {
+    // Group pattern positions by stop
+    visit_offsets_.assign(stops_.size() + 1, 0);
+    for (const StopIndex stop : pattern_stops_) {
+        ++visit_offsets_[stop + 1];
+    }
+    for (size_t i = 0; i < stops_.size(); ++i) {
+        visit_offsets_[i + 1] += visit_offsets_[i];
+    }
+    visits_.resize(pattern_stops_.size());
+    std::vector<size_t> fill(visit_offsets_.begin(), visit_offsets_.end() - 1);
+    for (PatternIndex pattern = 0; pattern < patterns_.size(); ++pattern) {
+        for (size_t position = 0; position < patterns_[pattern].length; ++position) {
+            const StopIndex stop = pattern_stops_[patterns_[pattern].first + position];
+            visits_[fill[stop]++] = { pattern, static_cast<uint32_t>(position) };
+        }
+    }
+}
+
+void RaptorRouter::AddPattern(const Bus* bus, const std::vector<const Stop*>& stops,
+                              const Catalogue& catalogue) {
+    patterns_.push_back({ bus, pattern_stops_.size(), stops.size() });
+    pattern_stops_.resize(pattern_stops_.size() + stops.size());
+    pattern_distances_.resize(pattern_stops_.size());
+    WritePattern(patterns_.back(), stops, catalogue);
+}
+
+void RaptorRouter::WritePattern(const Pattern& pattern, const std::vector<const Stop*>& stops,
+                                const Catalogue& catalogue) {
+    for (size_t i = 0; i < stops.size(); ++i) {
+        pattern_stops_[pattern.first + i] = stop_indices_.at(stops[i]->name);
+    }
+    ComputePatternDistances(pattern, catalogue);
+}
+
+void RaptorRouter::ComputePatternDistances(const Pattern& pattern, const Catalogue& catalogue) {
+    int64_t distance_sum = 0;
+    pattern_distances_[pattern.first] = 0;
+    for (size_t i = pattern.first + 1; i < pattern.first + pattern.length; ++i) {
+        distance_sum += catalogue.GetDistance(stops_[pattern_stops_[i - 1]], stops_[pattern_stops_[i]]);
+        pattern_distances_[i] = distance_sum;
+    }
+}
+
+double RaptorRouter::RideTime(const Pattern& pattern, uint32_t board_position,
+                              uint32_t alight_position) const {
+    const int64_t distance = pattern_distances_[pattern.first + alight_position]
+                             - pattern_distances_[pattern.first + board_position];
+    return distance / velocity_m_per_min_;
+}
+
+size_t RaptorRouter::Search(StopIndex from, std::optional<StopIndex> target, Scratch& scratch,
+                            double time_limit) const {
+    const size_t stop_count = stops_.size();
+    auto prepare_round = [&scratch, stop_count](size_t round) {
+        if (scratch.times.size() <= round) {
+            scratch.times.resize(round + 1);
+            scratch.parents.resize(round + 1);
+            scratch.improved_in.resize(round + 1);
+        }
+        if (round == 0) {
+            scratch.times[0].assign(stop_count, INFINITE_TIME);
+        } else {
+            scratch.times[round] = scratch.times[round - 1];
+        }
+        scratch.parents[round].resize(stop_count);
+        scratch.improved_in[round].assign(stop_count, false);
+    };
+
+    prepare_round(0);
+    scratch.times[0][from] = 0.0;
+    scratch.improved_in[0][from] = true;
+    scratch.marked.assign(stop_count, false);
+    scratch.marked_stops.assign(1, from);
+    scratch.pattern_first_position.assign(patterns_.size(), NO_POSITION);
+
+    size_t round = 0;
+    while (!scratch.marked_stops.empty()) {
+        ++round;
+        prepare_round(round);
+
+        // Patterns through the stops improved in the previous round, each from
+        // its earliest such stop
+        scratch.queued_patterns.clear();
+        for (const StopIndex stop : scratch.marked_stops) {
+            scratch.marked[stop] = false;
+            for (size_t i = visit_offsets_[stop]; i < visit_offsets_[stop + 1]; ++i) {
+                if (!patterns_[visits_[i].pattern].is_active) {
+                    continue;
+                }
+                uint32_t& first_position = scratch.pattern_first_position[visits_[i].pattern];
+                if (first_position == NO_POSITION) {
+                    scratch.queued_patterns.push_back(visits_[i].pattern);
+                }
+                first_position = std::min(first_position, visits_[i].position);
+            }
+        }
+        scratch.marked_stops.clear();
+
+        const std::vector<double>& previous_times = scratch.times[round - 1];
+        std::vector<double>& times = scratch.times[round];
+        for (const PatternIndex pattern_index : scratch.queued_patterns) {
+            const Pattern& pattern = patterns_[pattern_index];
+            const uint32_t first_position = scratch.pattern_first_position[pattern_index];
+            scratch.pattern_first_position[pattern_index] = NO_POSITION;
+
+            uint32_t board_position = NO_POSITION;
+            double board_time = INFINITE_TIME;  // time on board at board_position
+            for (uint32_t position = first_position; position < pattern.length; ++position) {
+                const StopIndex stop = pattern_stops_[pattern.first + position];
+                if (board_position != NO_POSITION) {
+                    const double arrival = board_time + RideTime(pattern, board_position, position);
+                    const double bound = target ? std::min(times[stop], times[*target]) : times[stop];
+                    if (arrival < bound && arrival <= time_limit) {
+                        times[stop] = arrival;
+                        scratch.parents[round][stop] = { pattern_index, board_position, position };
+                        scratch.improved_in[round][stop] = true;
+                        if (!scratch.marked[stop]) {
+                            scratch.marked[stop] = true;
+                            scratch.marked_stops.push_back(stop);
+                        }
+                    }
+                }
+                if (previous_times[stop] != INFINITE_TIME) {
+                    const double candidate = previous_times[stop] + bus_wait_time_;
+                    if (board_position == NO_POSITION
+                        || candidate < board_time + RideTime(pattern, board_position, position)) {
+                        board_position = position;
+                        board_time = candidate;
+                    }
+                }
+            }
+        }
+    }
+    return round;
+}
+
+std::optional<RaptorRouter::Journey> RaptorRouter::FindJourney(std::string_view from,
+                                                               std::string_view to) const {
+    Journey journey{};
+    const auto total_time = FindJourney(from, to, journey.legs);
+    if (!total_time) {
+        return std::nullopt;
+    }
+    journey.total_time = *total_time;
+    return journey;
+}
+
+std::optional<double> RaptorRouter::FindJourney(std::string_view from, std::string_view to,
+                                                std::vector<Leg>& legs) const {
+    legs.clear();
+    const auto from_it = stop_indices_.find(from);
+    const auto to_it = stop_indices_.find(to);
+    if (from_it == stop_indices_.end() || to_it == stop_indices_.end()) {
+        return std::nullopt;
+    }
+    Scratch& scratch = GetScratch();
+    const size_t round = Search(from_it->second, to_it->second, scratch);
+    return MakeJourney(scratch, round, from_it->second, to_it->second, legs);
+}
+
+std::vector<std::optional<RaptorRouter::Journey>> RaptorRouter::FindJourneys(
+    std::string_view from, const std::vector<std::string_view>& targets) const {
+    std::vector<std::optional<Journey>> journeys(targets.size());
+    const auto from_it = stop_indices_.find(from);
+    if (from_it == stop_indices_.end()) {
+        return journeys;
+    }
+
+    Scratch& scratch = GetScratch();
+    const size_t round = Search(from_it->second, std::nullopt, scratch);
+    for (size_t i = 0; i < targets.size(); ++i) {
+        if (const auto to_it = stop_indices_.find(targets[i]); to_it != stop_indices_.end()) {
+            Journey journey{};
+            if (const auto total_time = MakeJourney(scratch, round, from_it->second, to_it->second, journey.legs)) {
+                journey.total_time = *total_time;
+                journeys[i] = std::move(journey);
+            }
+        }
+    }
+    return journeys;
+}
+
+std::optional<std::vector<std::pair<const Stop*, double>>> RaptorRouter::FindReachableStops(
+    std::string_view from, double max_time) const {
+    const auto from_it = stop_indices_.find(from);
+    if (from_it == stop_indices_.end()) {
+        return std::nullopt;
+    }
+    std::vector<std::pair<const Stop*, double>> reachable;
+    if (max_time < 0.0) {
+        return reachable;
+    }
+
+    Scratch& scratch = GetScratch();
+    const size_t round = Search(from_it->second, std::nullopt, scratch, max_time);
+    const std::vector<double>& times = scratch.times[round];
+    for (StopIndex stop = 0; stop < stops_.size(); ++stop) {
+        if (times[stop] != INFINITE_TIME) {
+            reachable.emplace_back(stops_[stop], times[stop]);
+        }
+    }
+    return reachable;
+}
+
+std::optional<double> RaptorRouter::MakeJourney(const Scratch& scratch, size_t round, StopIndex from_index,
+                                                StopIndex to_index, std::vector<Leg>& legs) const {
+    legs.clear();
+    const double total_time = scratch.times[round][to_index];
+    if (total_time == INFINITE_TIME) {
+        return std::nullopt;
+    }
+
+    for (StopIndex stop = to_index; stop != from_index; --round) {
+        while (!scratch.improved_in[round][stop]) {
+            --round;
+        }
+        const Parent& parent = scratch.parents[round][stop];
+        const Pattern& pattern = patterns_[parent.pattern];
+        const StopIndex board_stop = pattern_stops_[pattern.first + parent.board_position];
+        legs.push_back({ stops_[board_stop], pattern.bus,
+                         static_cast<int>(parent.alight_position - parent.board_position),
+                         bus_wait_time_,
+                         RideTime(pattern, parent.board_position, parent.alight_position) });
+        stop = board_stop;
+    }
+    std::reverse(legs.begin(), legs.end());
+    return total_time;
+}
+
+}  // namespace transport
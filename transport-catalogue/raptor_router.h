@@ -0,0 +1,129 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "domain.h"
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace transport {
+
+// Round-based router in the spirit of RAPTOR. It works directly on the stop
+// sequences of the buses: each direction of a bus is a pattern with prefix sums
+// of road distances, and round k scans the patterns through the stops improved
+// in round k - 1, so a journey found in round k boards exactly k buses. Every
+// boarding costs bus_wait_time, like the Wait edges of transport::Router's graph.
+// Preprocessing and memory are linear in the total number of route stops.
+class RaptorRouter {
+public:
+    struct Leg {
+        const Stop* board_stop;
+        const Bus* bus;
+        int span_count;
+        double wait_time;
+        double ride_time;
+    };
+
+    struct Journey {
+        double total_time;
+        std::vector<Leg> legs;
+    };
+
+    RaptorRouter(const Catalogue& catalogue, int bus_wait_time, double bus_velocity);
+
+    std::optional<Journey> FindJourney(std::string_view from, std::string_view to) const;
+    // Writes the legs into legs, reusing its capacity, and returns the total time
+    std::optional<double> FindJourney(std::string_view from, std::string_view to, std::vector<Leg>& legs) const;
+    // One search without a target, then a journey to each of the targets
+    std::vector<std::optional<Journey>> FindJourneys(std::string_view from,
+                                                     const std::vector<std::string_view>& targets) const;
+
+    // Every stop reachable from `from` within max_time with its arrival time,
+    // std::nullopt for an unknown stop
+    std::optional<std::vector<std::pair<const Stop*, double>>> FindReachableStops(std::string_view from,
+                                                                                double max_time) const;
+
+    // Incremental updates; the catalogue must already contain the change. Adding a
+    // bus rebuilds the stop visits. Removed patterns are deactivated, and dropped
+    // together once they hold a fair share of the pattern stops
+    void AddBus(const Catalogue& catalogue, const Bus* bus);
+    void RemoveBus(std::string_view bus_name);
+    // Recomputes the road distances along the bus after SetDistance
+    void UpdateBusDistances(const Catalogue& catalogue, std::string_view bus_name);
+
+private:
+    using StopIndex = uint32_t;
+    using PatternIndex = uint32_t;
+
+    struct Pattern {
+        const Bus* bus;
+        size_t first;   // offset in pattern_stops_ and pattern_distances_
+        size_t length;
+        bool is_active = true;
+    };
+
+    // Where a stop occurs: pattern and position inside it
+    struct StopVisit {
+        PatternIndex pattern;
+        uint32_t position;
+    };
+
+    // How a stop was reached in some round
+    struct Parent {
+        PatternIndex pattern;
+        uint32_t board_position;
+        uint32_t alight_position;
+    };
+
+    struct Scratch {
+        std::vector<std::vector<double>> times;      // [round][stop]: best arrival with <= round buses
+        std::vector<std::vector<Parent>> parents;    // [round][stop]: valid when improved_in[round][stop]
+        std::vector<std::vector<bool>> improved_in;
+        std::vector<bool> marked;
+        std::vector<StopIndex> marked_stops;
+        std::vector<uint32_t> pattern_first_position;
+        std::vector<PatternIndex> queued_patterns;
+    };
+
+    static Scratch& GetScratch() {
+        thread_local Scratch scratch;
+        return scratch;
+    }
+
+    void AddPatterns(const Bus* bus, const Catalogue& catalogue);
+    void AddPattern(const Bus* bus, const std::vector<const Stop*>& stops, const Catalogue& catalogue);
+    // Stores the stops, as many as pattern.length, and their distances
+    void WritePattern(const Pattern& pattern, const std::vector<const Stop*>& stops, const Catalogue& catalogue);
+    void DeactivatePatterns(std::string_view bus_name);
+    // Drops the inactive patterns; the stop visits have to be rebuilt after it
+    void CompactPatterns();
+    void ComputePatternDistances(const Pattern& pattern, const Catalogue& catalogue);
+    void BuildVisits();
+    // Returns the number of the last round run. Arrivals later than time_limit are dropped
+    size_t Search(StopIndex from, std::optional<StopIndex> target, Scratch& scratch,
+                  double time_limit = std::numeric_limits<double>::infinity()) const;
+    double RideTime(const Pattern& pattern, uint32_t board_position, uint32_t alight_position) const;
+    // Replaces the contents of legs with the journey found by the last search
+    std::optional<double> MakeJourney(const Scratch& scratch, size_t round, StopIndex from, StopIndex to,
+                                      std::vector<Leg>& legs) const;
+
+    double bus_wait_time_ = 0.0;
+    double velocity_m_per_min_ = 0.0;
+
+    std::vector<const Stop*> stops_;
+    std::unordered_map<std::string_view, StopIndex> stop_indices_;
+
+    std::vector<Pattern> patterns_;
+    std::vector<StopIndex> pattern_stops_;
+    std::vector<int64_t> pattern_distances_;  // road meters from the first stop of the pattern
+    size_t inactive_stop_count_ = 0;          // pattern stops of the inactive patterns
+
+    std::vector<size_t> visit_offsets_;       // CSR: visits of stop s are [visit_offsets_[s], visit_offsets_[s + 1])
+    std::vector<StopVisit> visits_;
+};
+
+}  // namespace transport
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "graph.h"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace transport {
+
+// Size-bounded LRU cache of query results keyed by (from vertex, to vertex). Keys
+// are spread over SHARD_COUNT independently locked shards, so concurrent queries
+// rarely wait for each other. Each shard keeps capacity / SHARD_COUNT entries.
+template <typename Value>
+class RouteCache {
+public:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    // capacity is the total number of entries over all shards, 0 disables the cache
+    explicit RouteCache(size_t capacity)
+        : shard_capacity_((capacity + SHARD_COUNT - 1) / SHARD_COUNT)
+        , shards_(std::make_unique<Shard[]>(SHARD_COUNT)) {
+    }
+
+    RouteCache(const RouteCache&) = delete;
+    RouteCache& operator=(const RouteCache&) = delete;
+
+    bool IsEnabled() const {
+        return shard_capacity_ > 0;
+    }
+
+    // Copies the cached value to value and returns true on a hit
+    bool Find(graph::VertexId from, graph::VertexId to, Value& value) const;
+    void Insert(graph::VertexId from, graph::VertexId to, const Value& value);
+    // Drops all entries; the counters are kept
+    void Clear();
+
+    Stats GetStats() const {
+        return {hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed)};
+    }
+
+private:
+    using Key = std::pair<graph::VertexId, graph::VertexId>;
+
+    struct KeyHasher {
+        size_t operator()(const Key& key) const {
+            uint64_t hash = static_cast<uint64_t>(key.first) * 0x9E3779B97F4A7C15ull
+                            ^ static_cast<uint64_t>(key.second);
+            hash ^= hash >> 29;
+            hash *= 0xBF58476D1CE4E5B9ull;
+            return static_cast<size_t>(hash ^ (hash >> 32));
+        }
+    };
+
+    using EntryList = std::list<std::pair<Key, Value>>;
+
+    struct Shard {
+        std::mutex mutex;
+        EntryList entries;  // most recently used first
+        std::unordered_map<Key, typename EntryList::iterator, KeyHasher> index;
+    };
+
+    Shard& GetShard(const Key& key) const {
+        // The low bits pick the bucket inside the shard, so the shard uses the high ones
+        return shards_[(KeyHasher{}(key) >> 48) % SHARD_COUNT];
+    }
+
+    const size_t shard_capacity_;
+    std::unique_ptr<Shard[]> shards_;
+    mutable std::atomic<uint64_t> hits_ = 0;
+    mutable std::atomic<uint64_t> misses_ = 0;
+};
+
+template <typename Value>
+bool RouteCache<Value>::Find(graph::VertexId from, graph::VertexId to, Value& value) const {
+    if (!IsEnabled()) {
+        return false;
+    }
+    const Key key{from, to};
+    Shard& shard = GetShard(key);
+    {
+        std::lock_guard guard(shard.mutex);
+        if (const auto it = shard.index.find(key); it != shard.index.end()) {
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+            value = it->second->second;
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+template <typename Value>
+void RouteCache<Value>::Insert(graph::VertexId from, graph::VertexId to, const Value& value) {
+    if (!IsEnabled()) {
+        return;
+    }
+    const Key key{from, to};
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    if (const auto it = shard.index.find(key); it != shard.index.end()) {
+        it->second->second = value;
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+    shard.entries.emplace_front(key, value);
+    shard.index[key] = shard.entries.begin();
+    if (shard.entries.size() > shard_capacity_) {
+        shard.index.erase(shard.entries.back().first);
+        shard.entries.pop_back();
+    }
+}
+
+template <typename Value>
+void RouteCache<Value>::Clear() {
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        std::lock_guard guard(shards_[i].mutex);
+        shards_[i].entries.clear();
+        shards_[i].index.clear();
+    }
+}
+
+}  // namespace transport
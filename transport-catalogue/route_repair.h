@@ -0,0 +1,78 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Helpers for repairing precomputed routing state after edge updates. All the
+// table routers keep, per source, a shortest path tree: the weight of the best
+// route to every vertex and its last edge. Such a tree is still exact after a
+// batch of updates unless
+//   - an edge got heavier (or was removed or moved) and the tree uses it, or
+//   - an edge got lighter (or was added or moved) and it shortens the route to
+//     its head.
+// Only the trees failing this check have to be rebuilt.
+namespace graph {
+
+inline constexpr EdgeId NO_TREE_EDGE = std::numeric_limits<EdgeId>::max();
+
+// weight_to(v): weight of the best route from the source to v before the updates,
+// +inf if there was none; prev_edge_to(v): its last edge, or NO_TREE_EDGE
+template <typename Weight, typename WeightGetter, typename PrevEdgeGetter>
+bool IsTreeAffected(const DirectedWeightedGraph<Weight>& graph, const std::vector<EdgeUpdate<Weight>>& updates,
+                    WeightGetter weight_to, PrevEdgeGetter prev_edge_to) {
+    for (const auto& update : updates) {
+        const auto& old_edge = update.old_edge;
+        const auto& edge = graph.GetEdge(update.id);
+        const bool is_moved = edge.from != old_edge.from || edge.to != old_edge.to;
+        if ((is_moved || edge.weight > old_edge.weight) && prev_edge_to(old_edge.to) == update.id) {
+            return true;
+        }
+        if (is_moved || edge.weight < old_edge.weight) {
+            const Weight weight_to_from = weight_to(edge.from);
+            if (weight_to_from != WeightTraits<Weight>::INFINITE_WEIGHT
+                && weight_to_from + edge.weight < weight_to(edge.to)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Single-source Dijkstra; unreached vertices get +inf and NO_TREE_EDGE
+template <typename Weight>
+void BuildShortestPathTree(const DirectedWeightedGraph<Weight>& graph, VertexId from,
+                           std::vector<Weight>& weights, std::vector<EdgeId>& prev_edges) {
+    using HeapItem = std::pair<Weight, VertexId>;
+    const auto heap_compare = std::greater<HeapItem>{};
+
+    weights.assign(graph.GetVertexCount(), WeightTraits<Weight>::INFINITE_WEIGHT);
+    prev_edges.assign(graph.GetVertexCount(), NO_TREE_EDGE);
+    std::vector<HeapItem> heap;
+
+    weights[from] = WeightTraits<Weight>::ZERO_WEIGHT;
+    heap.push_back({WeightTraits<Weight>::ZERO_WEIGHT, from});
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_compare);
+        const auto [weight, vertex] = heap.back();
+        heap.pop_back();
+        if (weight > weights[vertex]) {
+            continue;
+        }
+        for (const auto& edge : graph.GetIncidentEdges(vertex)) {
+            const Weight candidate_weight = weight + edge.weight;
+            if (candidate_weight < weights[edge.to]) {
+                weights[edge.to] = candidate_weight;
+                prev_edges[edge.to] = edge.id;
+                heap.push_back({candidate_weight, edge.to});
+                std::push_heap(heap.begin(), heap.end(), heap_compare);
+            }
+        }
+    }
+}
+
+}  // namespace graph
@@ -0,0 +1,14 @@
+#pragma once
+
+namespace transport {
+
+inline constexpr double KM_TO_M = 1000.0;
+inline constexpr double HOUR_TO_MIN = 60.0;
+
+// Bus velocity of the routing settings, in km/h, as the meters per minute that
+// every routing engine divides road distances by, so their ride times agree
+inline constexpr double ToMetersPerMinute(double velocity_km_per_hour) {
+    return velocity_km_per_hour * KM_TO_M / HOUR_TO_MIN;
+}
+
+}  // namespace transport
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "weight_traits.h"
+
+namespace transport {
+
+// Weight of the routing graph edges. Minutes as double by default; building with
+// TRANSPORT_FIXED_POINT_WEIGHTS defined switches to graph::FixedPointWeight, with
+// exact integer sums and half the memory per weight in the routing tables.
+// Route times are reported in minutes either way
+#ifdef TRANSPORT_FIXED_POINT_WEIGHTS
+using RouteWeight = graph::FixedPointWeight;
+
+inline RouteWeight MinutesToWeight(double minutes) {
+    return RouteWeight::FromSeconds(minutes * 60.0);
+}
+
+inline double WeightToMinutes(RouteWeight weight) {
+    return weight.ToSeconds() / 60.0;
+}
+#else
+using RouteWeight = double;
+
+inline RouteWeight MinutesToWeight(double minutes) {
+    return minutes;
+}
+
+inline double WeightToMinutes(RouteWeight weight) {
+    return weight;
+}
+#endif
+
+}  // namespace transport
@@ -1,14 +1,18 @@
 #pragma once
 
 #include "graph.h"
+#include "route_repair.h"
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <iterator>
+#include <limits>
+#include <memory>
 #include <optional>
 #include <stdexcept>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -20,7 +24,19 @@ private:
     using Graph = DirectedWeightedGraph<Weight>;
 
 public:
+    // The whole table as one block of bytes: Weight[n * n], INFINITE_WEIGHT where
+    // there is no route, then from GetPrevEdgesOffset(n) EdgeId[n * n] with the
+    // last edge of each route
+    struct TableView {
+        const std::byte* data;
+        size_t size;
+    };
+
     explicit Router(const Graph& graph);
+    // Answers queries from a table saved with GetTable() for the same graph, e.g. a
+    // memory-mapped file, without running Floyd-Warshall again. The table is neither
+    // copied nor owned and must outlive the router
+    Router(const Graph& graph, TableView table);
 
     struct RouteInfo {
         Weight weight;
@@ -28,90 +44,175 @@ public:
     };
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    // Writes the edges of the route into edges, reusing its capacity, and returns
+    // the route weight
+    std::optional<Weight> BuildRoute(VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
+
+    // Recomputes the rows of the sources whose routes may have changed after updates
+    // of edges already applied to the graph. A borrowed table is copied first
+    void Repair(const std::vector<EdgeUpdate<Weight>>& updates);
+
+    TableView GetTable() const {
+        return {reinterpret_cast<const std::byte*>(weights_), GetTableSize(vertex_count_)};
+    }
+    static size_t GetTableSize(size_t vertex_count) {
+        return GetPrevEdgesOffset(vertex_count) + vertex_count * vertex_count * sizeof(EdgeId);
+    }
+    static size_t GetPrevEdgesOffset(size_t vertex_count) {
+        const size_t weights_size = vertex_count * vertex_count * sizeof(Weight);
+        return (weights_size + alignof(EdgeId) - 1) / alignof(EdgeId) * alignof(EdgeId);
+    }
 
 private:
-    struct RouteInternalData {
-        Weight weight;
-        std::optional<EdgeId> prev_edge;
-    };
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
-
-    void InitializeRoutesInternalData(const Graph& graph) {
-        const size_t vertex_count = graph.GetVertexCount();
-        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
-            for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
-                const auto& edge = graph.GetEdge(edge_id);
+    static constexpr Weight ZERO_WEIGHT = WeightTraits<Weight>::ZERO_WEIGHT;
+    static constexpr Weight INFINITE_WEIGHT = WeightTraits<Weight>::INFINITE_WEIGHT;
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+
+    void InitializeTable(const Graph& graph) {
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            weights_[Index(vertex, vertex)] = ZERO_WEIGHT;
+            for (const auto& edge : graph.GetIncidentEdges(vertex)) {
                 if (edge.weight < ZERO_WEIGHT) {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
+                const size_t index = Index(vertex, edge.to);
+                if (edge.weight < weights_[index]) {
+                    weights_[index] = edge.weight;
+                    prev_edges_[index] = edge.id;
                 }
             }
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-        const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-            route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
-        }
-    }
-
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
-                    }
+    void RelaxRoutesThroughVertex(VertexId vertex_through) {
+        const Weight* through_weights = weights_ + Index(vertex_through, 0);
+        const EdgeId* through_prev_edges = prev_edges_ + Index(vertex_through, 0);
+        for (VertexId vertex_from = 0; vertex_from < vertex_count_; ++vertex_from) {
+            const size_t from_through = Index(vertex_from, vertex_through);
+            const Weight weight_from = weights_[from_through];
+            if (weight_from == INFINITE_WEIGHT) {
+                continue;
+            }
+            const EdgeId prev_edge_from = prev_edges_[from_through];
+            Weight* row_weights = weights_ + Index(vertex_from, 0);
+            EdgeId* row_prev_edges = prev_edges_ + Index(vertex_from, 0);
+            for (VertexId vertex_to = 0; vertex_to < vertex_count_; ++vertex_to) {
+                if (through_weights[vertex_to] == INFINITE_WEIGHT) {
+                    continue;
+                }
+                const Weight candidate_weight = weight_from + through_weights[vertex_to];
+                if (candidate_weight < row_weights[vertex_to]) {
+                    row_weights[vertex_to] = candidate_weight;
+                    row_prev_edges[vertex_to] = through_prev_edges[vertex_to] != NO_EDGE
+                        ? through_prev_edges[vertex_to] : prev_edge_from;
                 }
             }
         }
     }
 
-    static constexpr Weight ZERO_WEIGHT{};
+    size_t Index(VertexId from, VertexId to) const {
+        return from * vertex_count_ + to;
+    }
+
     const Graph& graph_;
-    RoutesInternalData routes_internal_data_;
+    size_t vertex_count_ = 0;
+    std::unique_ptr<std::byte[]> table_;
+    Weight* weights_ = nullptr;
+    EdgeId* prev_edges_ = nullptr;
 };
 
 template <typename Weight>
 Router<Weight>::Router(const Graph& graph)
     : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+    , vertex_count_(graph.GetVertexCount())
+    , table_(std::make_unique<std::byte[]>(GetTableSize(vertex_count_)))
+    , weights_(reinterpret_cast<Weight*>(table_.get()))
+    , prev_edges_(reinterpret_cast<EdgeId*>(table_.get() + GetPrevEdgesOffset(vertex_count_)))
 {
-    InitializeRoutesInternalData(graph);
+    const size_t cell_count = vertex_count_ * vertex_count_;
+    std::fill(weights_, weights_ + cell_count, INFINITE_WEIGHT);
+    std::fill(prev_edges_, prev_edges_ + cell_count, NO_EDGE);
+    InitializeTable(graph);
 
-    const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+    for (VertexId vertex_through = 0; vertex_through < vertex_count_; ++vertex_through) {
+        RelaxRoutesThroughVertex(vertex_through);
     }
 }
 
 template <typename Weight>
-std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
-                                                                             VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-    if (!route_internal_data) {
-        return std::nullopt;
+Router<Weight>::Router(const Graph& graph, TableView table)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+{
+    if (table.size != GetTableSize(vertex_count_)
+        || reinterpret_cast<uintptr_t>(table.data) % std::max(alignof(Weight), alignof(EdgeId)) != 0) {
+        throw std::invalid_argument("Routing table does not match the graph");
     }
-    const Weight weight = route_internal_data->weight;
+    // The table is only read from here on
+    weights_ = reinterpret_cast<Weight*>(const_cast<std::byte*>(table.data));
+    prev_edges_ = reinterpret_cast<EdgeId*>(const_cast<std::byte*>(table.data) + GetPrevEdgesOffset(vertex_count_));
+}
+
+template <typename Weight>
+std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(
+    VertexId from, VertexId to) const {
     std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-         edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
-    {
-        edges.push_back(*edge_id);
+    const auto weight = BuildRoute(from, to, edges);
+    if (!weight) {
+        return std::nullopt;
+    }
+    return RouteInfo{*weight, std::move(edges)};
+}
+
+template <typename Weight>
+std::optional<Weight> Router<Weight>::BuildRoute(VertexId from, VertexId to, std::vector<EdgeId>& edges) const {
+    edges.clear();
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    const Weight weight = weights_[Index(from, to)];
+    if (weight == INFINITE_WEIGHT) {
+        return std::nullopt;
+    }
+    for (EdgeId edge_id = prev_edges_[Index(from, to)]; edge_id != NO_EDGE;
+         edge_id = prev_edges_[Index(from, graph_.GetEdge(edge_id).from)]) {
+        edges.push_back(edge_id);
     }
     std::reverse(edges.begin(), edges.end());
+    return weight;
+}
 
-    return RouteInfo{weight, std::move(edges)};
+template <typename Weight>
+void Router<Weight>::Repair(const std::vector<EdgeUpdate<Weight>>& updates) {
+    if (!table_) {
+        const size_t table_size = GetTableSize(vertex_count_);
+        auto table = std::make_unique<std::byte[]>(table_size);
+        std::memcpy(table.get(), weights_, table_size);
+        table_ = std::move(table);
+        weights_ = reinterpret_cast<Weight*>(table_.get());
+        prev_edges_ = reinterpret_cast<EdgeId*>(table_.get() + GetPrevEdgesOffset(vertex_count_));
+    }
+    std::vector<Weight> weights;
+    std::vector<EdgeId> prev_edges;
+    for (VertexId from = 0; from < vertex_count_; ++from) {
+        Weight* row_weights = weights_ + Index(from, 0);
+        EdgeId* row_prev_edges = prev_edges_ + Index(from, 0);
+        const bool is_affected = IsTreeAffected(graph_, updates,
+            [row_weights](VertexId vertex) {
+                return row_weights[vertex];
+            },
+            [row_prev_edges](VertexId vertex) {
+                return row_prev_edges[vertex] == NO_EDGE ? NO_TREE_EDGE : row_prev_edges[vertex];
+            });
+        if (!is_affected) {
+            continue;
+        }
+        BuildShortestPathTree(graph_, from, weights, prev_edges);
+        for (VertexId to = 0; to < vertex_count_; ++to) {
+            row_weights[to] = weights[to];
+            row_prev_edges[to] = prev_edges[to] == NO_TREE_EDGE ? NO_EDGE : prev_edges[to];
+        }
+    }
 }
 
 }  // namespace graph
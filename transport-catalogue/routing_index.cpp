@@ -0,0 +1,205 @@
+#include "routing_index.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace transport {
+
+namespace {
+
+constexpr char MAGIC[8] = {'T', 'C', 'R', 'O', 'U', 'T', 'E', '\0'};
+constexpr uint64_t SECTION_ALIGNMENT = 64;
+
+enum Section {
+    EDGES,
+    VERTEX_OFFSETS,
+    INCIDENT_EDGES,
+    BUS_INDICES,
+    STOP_INDICES,
+    SPAN_COUNTS,
+    TIMES,
+    BUS_EDGES,
+    TABLE,
+    SECTION_COUNT,
+};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t engine;
+    uint64_t key;
+    uint32_t edge_size;
+    uint32_t incident_edge_size;
+    uint64_t vertex_count;
+    uint64_t edge_count;
+    uint64_t bus_count;
+    uint64_t table_stride;
+    uint64_t section_offsets[SECTION_COUNT];
+    uint64_t section_sizes[SECTION_COUNT];
+    uint64_t file_size;
+};
+
+uint64_t AlignUp(uint64_t offset) {
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+// Sizes of all sections but the table, which the engine determines
+void SetArraySizes(FileHeader& header) {
+    header.section_sizes[EDGES] = header.edge_count * sizeof(graph::Edge<RouteWeight>);
+    header.section_sizes[VERTEX_OFFSETS] = (header.vertex_count + 1) * sizeof(size_t);
+    header.section_sizes[INCIDENT_EDGES] = header.edge_count * sizeof(graph::IncidentEdge<RouteWeight>);
+    header.section_sizes[BUS_INDICES] = header.edge_count * sizeof(uint32_t);
+    header.section_sizes[STOP_INDICES] = header.edge_count * sizeof(uint32_t);
+    header.section_sizes[SPAN_COUNTS] = header.edge_count * sizeof(int32_t);
+    header.section_sizes[TIMES] = header.edge_count * sizeof(double);
+    header.section_sizes[BUS_EDGES] = header.bus_count * sizeof(RoutingIndex::BusEdges);
+}
+
+} // namespace
+
+bool RoutingIndex::Save(const std::string& path, const Contents& contents) {
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FORMAT_VERSION;
+    header.engine = contents.engine;
+    header.key = contents.key;
+    header.edge_size = sizeof(graph::Edge<RouteWeight>);
+    header.incident_edge_size = sizeof(graph::IncidentEdge<RouteWeight>);
+    header.vertex_count = contents.vertex_count;
+    header.edge_count = contents.edge_count;
+    header.bus_count = contents.bus_count;
+    header.table_stride = contents.table ? contents.table_stride : 0;
+    SetArraySizes(header);
+    header.section_sizes[TABLE] = contents.table ? contents.table_size : 0;
+
+    const void* const sections[SECTION_COUNT] = {
+        contents.edges, contents.vertex_offsets, contents.incident_edges, contents.bus_indices,
+        contents.stop_indices, contents.span_counts, contents.times, contents.bus_edges, contents.table,
+    };
+    uint64_t offset = sizeof(FileHeader);
+    for (size_t section = 0; section < SECTION_COUNT; ++section) {
+        header.section_offsets[section] = AlignUp(offset);
+        offset = header.section_offsets[section] + header.section_sizes[section];
+    }
+    header.file_size = offset;
+
+    const std::string temp_path = path + ".tmp" + std::to_string(::getpid());
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        auto write_at = [&out](uint64_t offset, const void* data, size_t size) {
+            static const char padding[SECTION_ALIGNMENT] = {};
+            const uint64_t position = static_cast<uint64_t>(out.tellp());
+            out.write(padding, static_cast<std::streamsize>(offset - position));
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        };
+        write_at(0, &header, sizeof(header));
+        for (size_t section = 0; section < SECTION_COUNT; ++section) {
+            write_at(header.section_offsets[section], sections[section], header.section_sizes[section]);
+        }
+        if (!out) {
+            std::remove(temp_path.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<RoutingIndex> RoutingIndex::Open(const std::string& path, uint64_t key, uint32_t engine) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat file_stat{};
+    if (::fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(FileHeader)) {
+        ::close(fd);
+        return nullptr;
+    }
+    const size_t file_size = static_cast<size_t>(file_stat.st_size);
+    void* mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+
+    std::unique_ptr<RoutingIndex> index(new RoutingIndex());
+    index->mapping_ = mapping;
+    index->mapping_size_ = file_size;
+
+    const auto* base = static_cast<const std::byte*>(mapping);
+    const auto& header = *reinterpret_cast<const FileHeader*>(base);
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+        || header.version != FORMAT_VERSION
+        || header.engine != engine
+        || header.key != key
+        || header.edge_size != sizeof(graph::Edge<RouteWeight>)
+        || header.incident_edge_size != sizeof(graph::IncidentEdge<RouteWeight>)
+        || header.file_size != file_size) {
+        return nullptr;
+    }
+    FileHeader expected = header;
+    SetArraySizes(expected);
+    for (size_t section = 0; section < SECTION_COUNT; ++section) {
+        const uint64_t offset = header.section_offsets[section];
+        const uint64_t size = header.section_sizes[section];
+        if (offset % SECTION_ALIGNMENT != 0 || offset > file_size || size > file_size - offset
+            || (section != TABLE && size != expected.section_sizes[section])) {
+            return nullptr;
+        }
+    }
+
+    auto section = [base, &header](Section section) {
+        return base + header.section_offsets[section];
+    };
+    Contents& contents = index->contents_;
+    contents.key = header.key;
+    contents.engine = header.engine;
+    contents.vertex_count = header.vertex_count;
+    contents.edge_count = header.edge_count;
+    contents.bus_count = header.bus_count;
+    contents.edges = reinterpret_cast<const graph::Edge<RouteWeight>*>(section(EDGES));
+    contents.vertex_offsets = reinterpret_cast<const size_t*>(section(VERTEX_OFFSETS));
+    contents.incident_edges = reinterpret_cast<const graph::IncidentEdge<RouteWeight>*>(section(INCIDENT_EDGES));
+    contents.bus_indices = reinterpret_cast<const uint32_t*>(section(BUS_INDICES));
+    contents.stop_indices = reinterpret_cast<const uint32_t*>(section(STOP_INDICES));
+    contents.span_counts = reinterpret_cast<const int32_t*>(section(SPAN_COUNTS));
+    contents.times = reinterpret_cast<const double*>(section(TIMES));
+    contents.bus_edges = reinterpret_cast<const BusEdges*>(section(BUS_EDGES));
+    contents.table = header.section_sizes[TABLE] ? section(TABLE) : nullptr;
+    contents.table_size = header.section_sizes[TABLE];
+    contents.table_stride = header.table_stride;
+    if (contents.vertex_offsets[0] != 0 || contents.vertex_offsets[contents.vertex_count] != contents.edge_count) {
+        return nullptr;
+    }
+    return index;
+}
+
+RoutingIndex::~RoutingIndex() {
+    if (mapping_) {
+        ::munmap(mapping_, mapping_size_);
+    }
+}
+
+RoutingKeyBuilder& RoutingKeyBuilder::Add(const void* data, size_t size) {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash_ = (hash_ ^ bytes[i]) * 1099511628211ull;
+    }
+    return *this;
+}
+
+RoutingKeyBuilder& RoutingKeyBuilder::Add(std::string_view value) {
+    Add(value.size());
+    return Add(value.data(), value.size());
+}
+
+}  // namespace transport
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "graph.h"
+#include "route_weight.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace transport {
+
+// Versioned binary file with a built routing graph, its edge metadata and
+// (for the all-pairs engines) the precomputed all-pairs table. The file is
+// opened with mmap, and the router uses every section in place, without parsing
+// or copying, so processes that open the same file share their pages.
+//
+// Layout: FileHeader, then one section per array of Contents, each at an offset
+// aligned to SECTION_ALIGNMENT. Everything is stored in the native byte order;
+// the header records the sizes of the stored structs so a file written by an
+// incompatible build is rejected instead of misread.
+class RoutingIndex {
+public:
+    static constexpr uint32_t FORMAT_VERSION = 3;
+    static constexpr uint32_t NO_INDEX = UINT32_MAX;
+
+    // The edges of a bus have consecutive ids
+    struct BusEdges {
+        uint64_t first;
+        uint64_t count;
+    };
+
+    struct Contents {
+        uint64_t key = 0;
+        uint32_t engine = 0;
+        size_t vertex_count = 0;
+        size_t edge_count = 0;
+        size_t bus_count = 0;
+        // The frozen graph, see DirectedWeightedGraph::CsrView: edges by id,
+        // vertex_count + 1 offsets and the incident edges grouped by source vertex
+        const graph::Edge<RouteWeight>* edges = nullptr;
+        const size_t* vertex_offsets = nullptr;
+        const graph::IncidentEdge<RouteWeight>* incident_edges = nullptr;
+        // Edge metadata by edge id: indices into the name-sorted buses and into the
+        // stops in the vertex order of the router
+        const uint32_t* bus_indices = nullptr;   // NO_INDEX for a Wait edge
+        const uint32_t* stop_indices = nullptr;  // NO_INDEX for a Bus edge
+        const int32_t* span_counts = nullptr;
+        const double* times = nullptr;
+        const BusEdges* bus_edges = nullptr;     // by bus index
+        const std::byte* table = nullptr;        // may be null
+        size_t table_size = 0;
+        size_t table_stride = 0;
+    };
+
+    // Writes to a temporary file and renames it over path, so readers never see
+    // a partially written index. Returns false on I/O errors
+    static bool Save(const std::string& path, const Contents& contents);
+
+    // Returns nullptr if the file is missing, malformed, of another format version,
+    // or was built for another key or engine. Only the header and the section
+    // bounds are checked: the arrays are trusted once the key matches
+    static std::unique_ptr<RoutingIndex> Open(const std::string& path, uint64_t key, uint32_t engine);
+
+    RoutingIndex(const RoutingIndex&) = delete;
+    RoutingIndex& operator=(const RoutingIndex&) = delete;
+    ~RoutingIndex();
+
+    // Views into the mapped file, valid while the index is alive
+    const Contents& GetContents() const {
+        return contents_;
+    }
+
+private:
+    RoutingIndex() = default;
+
+    void* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+    Contents contents_;
+};
+
+// FNV-1a over everything that affects the built routing data: routing settings
+// and the stops, buses and road distances along the buses
+class RoutingKeyBuilder {
+public:
+    RoutingKeyBuilder& Add(const void* data, size_t size);
+    // Only plain values are hashed by their bytes: a pointer or a string object
+    // would give a different key on every run
+    template <typename T, std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>, int> = 0>
+    RoutingKeyBuilder& Add(T value) {
+        return Add(&value, sizeof(value));
+    }
+    // The size and then the characters
+    RoutingKeyBuilder& Add(std::string_view value);
+    uint64_t Get() const {
+        return hash_;
+    }
+
+private:
+    uint64_t hash_ = 14695981039346656037ull;
+};
+
+}  // namespace transport
@@ -0,0 +1,173 @@
+#include "stop_order.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <queue>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace transport {
+
+namespace {
+
+using StopIndex = uint32_t;
+// Stop indices in name order; neighbors ascending and without duplicates
+using Adjacency = std::vector<std::vector<StopIndex>>;
+
+constexpr uint32_t HILBERT_GRID_SIZE = 1u << 16;
+
+Adjacency MakeAdjacency(const Catalogue& catalogue, const std::vector<const Stop*>& stops) {
+    std::unordered_map<std::string_view, StopIndex> indices;
+    for (StopIndex i = 0; i < stops.size(); ++i) {
+        indices[stops[i]->name] = i;
+    }
+    Adjacency adjacency(stops.size());
+    for (const auto& [bus_name, bus] : catalogue.GetSortedAllBuses()) {
+        for (size_t i = 1; i < bus->stops.size(); ++i) {
+            const StopIndex from = indices.at(bus->stops[i - 1]->name);
+            const StopIndex to = indices.at(bus->stops[i]->name);
+            if (from != to) {
+                adjacency[from].push_back(to);
+                adjacency[to].push_back(from);
+            }
+        }
+    }
+    for (auto& neighbors : adjacency) {
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+    }
+    return adjacency;
+}
+
+// Breadth-first order of every component. Components start from the vertex that
+// compares least by start_less, neighbors are queued in ascending visit_less order
+template <typename StartLess, typename VisitLess>
+std::vector<StopIndex> OrderBreadthFirst(const Adjacency& adjacency, StartLess start_less, VisitLess visit_less) {
+    const size_t stop_count = adjacency.size();
+    std::vector<StopIndex> starts(stop_count);
+    for (StopIndex i = 0; i < stop_count; ++i) {
+        starts[i] = i;
+    }
+    std::stable_sort(starts.begin(), starts.end(), start_less);
+
+    std::vector<StopIndex> order;
+    order.reserve(stop_count);
+    std::vector<bool> is_visited(stop_count, false);
+    std::vector<StopIndex> neighbors;
+    for (const StopIndex start : starts) {
+        if (is_visited[start]) continue;
+        is_visited[start] = true;
+        // order doubles as the queue: the component is [head, order.size())
+        size_t head = order.size();
+        order.push_back(start);
+        for (; head < order.size(); ++head) {
+            neighbors.clear();
+            for (const StopIndex neighbor : adjacency[order[head]]) {
+                if (!is_visited[neighbor]) {
+                    is_visited[neighbor] = true;
+                    neighbors.push_back(neighbor);
+                }
+            }
+            std::stable_sort(neighbors.begin(), neighbors.end(), visit_less);
+            order.insert(order.end(), neighbors.begin(), neighbors.end());
+        }
+    }
+    return order;
+}
+
+// Distance along the Hilbert curve of order 16 through the point (x, y)
+uint64_t GetHilbertIndex(uint32_t x, uint32_t y) {
+    uint64_t index = 0;
+    for (uint32_t side = HILBERT_GRID_SIZE / 2; side > 0; side /= 2) {
+        const uint32_t rx = (x & side) > 0 ? 1 : 0;
+        const uint32_t ry = (y & side) > 0 ? 1 : 0;
+        index += static_cast<uint64_t>(side) * side * ((3 * rx) ^ ry);
+        // Rotate the quadrant so the curve inside it has the base orientation
+        if (ry == 0) {
+            if (rx == 1) {
+                x = HILBERT_GRID_SIZE - 1 - x;
+                y = HILBERT_GRID_SIZE - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
+}
+
+std::vector<StopIndex> OrderHilbert(const std::vector<const Stop*>& stops) {
+    if (stops.empty()) {
+        return {};
+    }
+    auto [min_lat, max_lat] = std::make_pair(stops[0]->coordinates.lat, stops[0]->coordinates.lat);
+    auto [min_lng, max_lng] = std::make_pair(stops[0]->coordinates.lng, stops[0]->coordinates.lng);
+    for (const Stop* stop : stops) {
+        min_lat = std::min(min_lat, stop->coordinates.lat);
+        max_lat = std::max(max_lat, stop->coordinates.lat);
+        min_lng = std::min(min_lng, stop->coordinates.lng);
+        max_lng = std::max(max_lng, stop->coordinates.lng);
+    }
+    auto to_grid = [](double value, double min_value, double max_value) {
+        if (!(max_value > min_value)) {
+            return 0u;
+        }
+        return static_cast<uint32_t>((value - min_value) / (max_value - min_value) * (HILBERT_GRID_SIZE - 1));
+    };
+
+    std::vector<std::pair<uint64_t, StopIndex>> keys;
+    keys.reserve(stops.size());
+    for (StopIndex i = 0; i < stops.size(); ++i) {
+        keys.emplace_back(GetHilbertIndex(to_grid(stops[i]->coordinates.lng, min_lng, max_lng),
+                                          to_grid(stops[i]->coordinates.lat, min_lat, max_lat)),
+                          i);
+    }
+    std::sort(keys.begin(), keys.end());
+    std::vector<StopIndex> order;
+    order.reserve(stops.size());
+    for (const auto& [key, stop] : keys) {
+        order.push_back(stop);
+    }
+    return order;
+}
+
+} // namespace
+
+std::vector<const Stop*> OrderStops(const Catalogue& catalogue, VertexOrder order) {
+    std::vector<const Stop*> stops;
+    for (const auto& [stop_name, stop] : catalogue.GetSortedAllStops()) {
+        stops.push_back(stop);
+    }
+    if (order == VertexOrder::NAME) {
+        return stops;
+    }
+
+    std::vector<StopIndex> permutation;
+    if (order == VertexOrder::HILBERT) {
+        permutation = OrderHilbert(stops);
+    } else {
+        const Adjacency adjacency = MakeAdjacency(catalogue, stops);
+        const auto by_index = [](StopIndex lhs, StopIndex rhs) {
+            return lhs < rhs;
+        };
+        const auto by_degree = [&adjacency](StopIndex lhs, StopIndex rhs) {
+            return adjacency[lhs].size() < adjacency[rhs].size();
+        };
+        if (order == VertexOrder::BFS) {
+            permutation = OrderBreadthFirst(adjacency, by_index, by_index);
+        } else {
+            // Cuthill-McKee starts from a vertex of least degree and visits the
+            // neighbors by increasing degree; reversing it gives a smaller profile
+            permutation = OrderBreadthFirst(adjacency, by_degree, by_degree);
+            std::reverse(permutation.begin(), permutation.end());
+        }
+    }
+
+    std::vector<const Stop*> ordered;
+    ordered.reserve(stops.size());
+    for (const StopIndex stop : permutation) {
+        ordered.push_back(stops[stop]);
+    }
+    return ordered;
+}
+
+}  // namespace transport
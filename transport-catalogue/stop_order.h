@@ -0,0 +1,25 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "domain.h"
+
+#include <vector>
+
+namespace transport {
+
+// Order in which the router numbers the stops, and with them the graph
+// vertices: stop i gets vertices 2i and 2i + 1 and Wait edge i
+enum class VertexOrder {
+    NAME,     // alphabetical
+    BFS,      // breadth-first over the stops adjacent along some bus
+    RCM,      // reverse Cuthill-McKee over the same adjacency
+    HILBERT,  // along a Hilbert curve over the stop coordinates
+};
+
+// All stops of the catalogue in the given order. The result depends only on the
+// catalogue, so the same catalogue always gets the same numbering. The graph
+// orders put stops that are close in the network next to each other, so the
+// searches and the all-pairs relaxation touch fewer cache lines
+std::vector<const Stop*> OrderStops(const Catalogue& catalogue, VertexOrder order);
+
+}  // namespace transport
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstring>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_set>
+
+namespace transport {
+
+// Interned strings allocated from a memory resource: equal strings are stored
+// once, and the views returned by Intern stay valid while the resource lives.
+// Only the characters go to the resource; the lookup set rehashes as it grows,
+// so it uses the default allocator
+class StringPool {
+public:
+    explicit StringPool(std::pmr::memory_resource* resource)
+        : resource_(resource) {
+    }
+
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    std::string_view Intern(std::string_view value) {
+        if (const auto it = strings_.find(value); it != strings_.end()) {
+            return *it;
+        }
+        char* data = static_cast<char*>(resource_->allocate(value.size(), alignof(char)));
+        std::memcpy(data, value.data(), value.size());
+        return *strings_.emplace(data, value.size()).first;
+    }
+
+    void Reserve(size_t count) {
+        strings_.reserve(count);
+    }
+
+private:
+    std::pmr::memory_resource* resource_;
+    std::unordered_set<std::string_view> strings_;
+};
+
+}  // namespace transport
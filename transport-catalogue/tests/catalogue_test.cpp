@@ -0,0 +1,160 @@
+// Bulk loading, Freeze() and Thaw() of the catalogue, including records that
+// name unknown stops.
+//
+// Build and run from transport-catalogue/, with all sources but main.cpp and the
+// stale stat_reader.cpp, input_reader.cpp and request_handler.cpp:
+//   g++ -std=c++17 -O2 -pthread -I. -o catalogue_test tests/catalogue_test.cpp connection_scan_router.cpp distance_table.cpp domain.cpp geo.cpp json.cpp json_builder.cpp json_reader.cpp map_renderer.cpp raptor_router.cpp routing_index.cpp stop_order.cpp svg.cpp transport_catalogue.cpp transport_router.cpp
+//   ./catalogue_test
+
+#include "json_reader.h"
+#include "transport_catalogue.h"
+
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace transport;
+
+namespace {
+
+void TestBulkLoad() {
+    Catalogue catalogue;
+    catalogue.AddStop("Z", {55.62, 37.52});
+    catalogue.Reserve(2, 2, 2);
+    // Records may come before the stops they name
+    catalogue.LoadRoute("b", {"A", "B", "Z"}, false);
+    catalogue.LoadDistance("A", "B", 1000);
+    catalogue.LoadStop("B", {55.61, 37.51});
+    catalogue.LoadStop("A", {55.6, 37.5});
+    catalogue.LoadRoute("a", {"B", "Z"}, true);
+    catalogue.LoadRoute("b", {"A", "B"}, false);  // replaces the first record of "b"
+    assert(!catalogue.FindStop("A"));
+    assert(!catalogue.IsFrozen());
+
+    catalogue.Freeze();
+    assert(catalogue.IsFrozen());
+    const Stop* a = catalogue.FindStop("A");
+    const Stop* b = catalogue.FindStop("B");
+    const Stop* z = catalogue.FindStop("Z");
+    assert(a && b && z);
+    // Mirrored until set in the other direction
+    assert(catalogue.GetDistance(a, b) == 1000 && catalogue.GetDistance(b, a) == 1000);
+
+    const Bus* bus_b = catalogue.FindRoute("b");
+    assert(bus_b && bus_b->stops.size() == 2);
+    assert(bus_b->stat.stops_count == 3 && bus_b->stat.unique_stops_count == 2);
+    assert(bus_b->stat.route_length == 2000);
+    assert(catalogue.GetSortedAllBuses().size() == 2);
+    assert(catalogue.GetSortedAllStops().size() == 3);
+    assert(b->buses_by_stop.size() == 2 && b->buses_by_stop[0]->number == "a");
+    assert(z->buses_by_stop.size() == 1);
+
+    // A frozen catalogue is read-only
+    bool is_rejected = false;
+    try {
+        catalogue.AddStop("Q", {55.6, 37.6});
+    } catch (const std::logic_error&) {
+        is_rejected = true;
+    }
+    assert(is_rejected);
+}
+
+void TestUnknownStops() {
+    Catalogue catalogue;
+    catalogue.LoadStop("A", {55.6, 37.5});
+    catalogue.LoadStop("B", {55.61, 37.51});
+    catalogue.LoadDistance("A", "Nowhere", 500);
+    catalogue.LoadDistance("Nowhere", "B", 500);
+    catalogue.LoadDistance("A", "B", 1000);
+    catalogue.LoadRoute("1", {"A", "Ghost", "B"}, false);
+    catalogue.LoadRoute("2", {"Ghost"}, true);
+    catalogue.Freeze();
+
+    const Bus* bus = catalogue.FindRoute("1");
+    assert(bus && bus->stops.size() == 2);
+    assert(bus->stat.route_length == 2000);
+    assert(!catalogue.FindRoute("2"));
+    assert(!catalogue.FindStop("Nowhere"));
+}
+
+void TestUnknownStopsInJson() {
+    std::istringstream input(R"({
+        "base_requests": [
+            {"type": "Stop", "name": "A", "latitude": 55.6, "longitude": 37.5,
+             "road_distances": {"B": 1000, "Nowhere": 500}},
+            {"type": "Stop", "name": "B", "latitude": 55.61, "longitude": 37.51, "road_distances": {}},
+            {"type": "Bus", "name": "1", "stops": ["A", "Ghost", "B"], "is_roundtrip": false}
+        ],
+        "stat_requests": []
+    })");
+    json_reader::JsonReader reader(input);
+    Catalogue catalogue;
+    reader.FillCatalogue(catalogue);
+    assert(catalogue.FindRoute("1") && catalogue.FindRoute("1")->stat.route_length == 2000);
+}
+
+// The timetables alone cannot answer a Route request without a departure_time,
+// so such a request is refused up front rather than answered "not found"
+void TestConnectionScanNeedsDepartures() {
+    const std::string requests = R"({
+        "base_requests": [
+            {"type": "Stop", "name": "A", "latitude": 55.6, "longitude": 37.5, "road_distances": {"B": 1000}},
+            {"type": "Stop", "name": "B", "latitude": 55.61, "longitude": 37.51, "road_distances": {}},
+            {"type": "Bus", "name": "1", "stops": ["A", "B"], "is_roundtrip": false, "departures": [600]}
+        ],
+        "routing_settings": {"bus_wait_time": 2, "bus_velocity": 30, "routing_engine": "connection_scan"},
+        "stat_requests": [
+            {"id": 1, "type": "Route", "from": "A", "to": "B", "departure_time": 590})";
+    for (const std::string& other_request : {std::string(), std::string(R"(,
+            {"id": 2, "type": "Route", "from": "A", "to": "B"})")}) {
+        std::istringstream input(requests + other_request + "]}");
+        json_reader::JsonReader reader(input);
+        Catalogue catalogue;
+        reader.FillCatalogue(catalogue);
+        bool is_refused = false;
+        try {
+            reader.MakeLazyRouter(catalogue);
+        } catch (const std::logic_error&) {
+            is_refused = true;
+        }
+        assert(is_refused == !other_request.empty());
+    }
+}
+
+void TestThaw() {
+    Catalogue catalogue;
+    catalogue.LoadStop("A", {55.6, 37.5});
+    catalogue.LoadStop("B", {55.61, 37.51});
+    catalogue.LoadRoute("1", {"A", "B"}, true);
+    catalogue.Freeze();
+
+    catalogue.Thaw();
+    assert(!catalogue.IsFrozen());
+    catalogue.AddStop("C", {55.62, 37.52});
+    const Stop* a = catalogue.FindStop("A");
+    const Stop* c = catalogue.FindStop("C");
+    catalogue.SetDistance(a, c, 700);
+    catalogue.AddRoute("2", {a, c, a}, true);
+    assert(catalogue.FindRoute("2")->stat.route_length == 1400);
+    assert(a->buses_by_stop.size() == 2);
+
+    // More records can be loaded and frozen again
+    catalogue.LoadStop("D", {55.63, 37.53});
+    catalogue.LoadRoute("3", {"C", "D"}, false);
+    catalogue.Freeze();
+    assert(catalogue.FindRoute("3") && catalogue.GetSortedAllBuses().size() == 3);
+}
+
+}  // namespace
+
+int main() {
+    TestBulkLoad();
+    TestUnknownStops();
+    TestUnknownStopsInJson();
+    TestConnectionScanNeedsDepartures();
+    TestThaw();
+    std::cout << "catalogue_test: OK" << std::endl;
+}
@@ -0,0 +1,113 @@
+// Router::FindReachableStops returns exactly the stops whose route from the
+// origin fits in the time budget, with the route times, for every engine.
+//
+// Build and run from transport-catalogue/, with the sources of the catalogue and
+// the router (no JSON or SVG):
+//   g++ -std=c++17 -O2 -pthread -I. -o isochrone_test tests/isochrone_test.cpp connection_scan_router.cpp distance_table.cpp domain.cpp geo.cpp raptor_router.cpp routing_index.cpp stop_order.cpp transport_catalogue.cpp transport_router.cpp
+//   ./isochrone_test
+// and once more with -DTRANSPORT_FIXED_POINT_WEIGHTS, whose budgets saturate at
+// a finite maximum
+
+#include "sample_network.h"
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+
+using namespace transport;
+
+namespace {
+
+// Budgets that fall this close to a route time could go either way
+constexpr double TIME_TOLERANCE = 1e-6;
+
+void CheckReachableStops(const Router& expected, const Router& router, const tests::SampleNetwork& network,
+                         const std::string& from, double max_time) {
+    const auto reachable = router.FindReachableStops(from, max_time);
+    assert(reachable);
+
+    std::map<std::string_view, double> times;
+    for (size_t i = 0; i < reachable->size(); ++i) {
+        const ReachableStop& stop = (*reachable)[i];
+        assert(times.emplace(stop.stop_name, stop.time).second);
+        if (i > 0) {
+            const ReachableStop& previous = (*reachable)[i - 1];
+            assert(previous.time < stop.time || (previous.time == stop.time && previous.stop_name < stop.stop_name));
+        }
+    }
+    assert(times.count(from) && times.at(from) == 0.0);
+
+    for (const std::string& to : network.stop_names) {
+        if (to == from) {
+            continue;
+        }
+        const auto route = expected.FindRoute(from, to);
+        const auto it = times.find(to);
+        if (route && route->total_time <= max_time - TIME_TOLERANCE) {
+            assert(it != times.end() && std::abs(it->second - route->total_time) < 1e-4 * (1.0 + route->total_time));
+        } else if (!route || route->total_time > max_time + TIME_TOLERANCE) {
+            assert(it == times.end());
+        }
+    }
+}
+
+void TestReachableStopsMatchRoutes() {
+    Catalogue catalogue;
+    const tests::SampleNetwork network = tests::LoadSampleNetwork(catalogue, 7, 50, 20);
+    const Router expected(catalogue, tests::MakeSettings(RouterEngine::ALL_PAIRS));
+
+    for (const RouterEngine engine : {RouterEngine::ALL_PAIRS, RouterEngine::DIJKSTRA,
+                                      RouterEngine::CONTRACTION_HIERARCHIES, RouterEngine::BLOCKED_ALL_PAIRS,
+                                      RouterEngine::COMPACT_ALL_PAIRS, RouterEngine::RAPTOR, RouterEngine::ALT}) {
+        const Router router(catalogue, tests::MakeSettings(engine));
+        for (size_t i = 0; i < network.stop_names.size(); i += 7) {
+            for (const double max_time : {0.0, 10.0, 25.0, 60.0, 1000.0}) {
+                CheckReachableStops(expected, router, network, network.stop_names[i], max_time);
+            }
+        }
+        assert(!router.FindReachableStops("Nowhere", 60.0));
+    }
+}
+
+void TestNegativeBudget() {
+    Catalogue catalogue;
+    tests::LoadSampleNetwork(catalogue, 8, 10, 4);
+    const Router router(catalogue, tests::MakeSettings(RouterEngine::DIJKSTRA));
+    const auto reachable = router.FindReachableStops("Stop 0", -1.0);
+    assert(reachable && reachable->empty());
+}
+
+// A budget past the largest weight (about 715,827 minutes with fixed-point
+// weights) must not reach the stops through the +inf edges of a removed bus
+void TestRemovedBusWithHugeBudget() {
+    Catalogue catalogue;
+    const tests::SampleNetwork network = tests::LoadSampleNetwork(catalogue, 11, 30, 10);
+    Router router(catalogue, tests::MakeSettings(RouterEngine::DIJKSTRA));
+    catalogue.Thaw();
+    for (size_t i = 0; i < 3; ++i) {
+        catalogue.RemoveRoute(network.bus_numbers[i]);
+        router.RemoveBus(network.bus_numbers[i]);
+    }
+    const Router expected(catalogue, tests::MakeSettings(RouterEngine::DIJKSTRA));
+
+    for (const std::string& from : network.stop_names) {
+        const auto reachable = router.FindReachableStops(from, 1e9);
+        const auto expected_reachable = expected.FindReachableStops(from, 1e9);
+        assert(reachable && expected_reachable && reachable->size() == expected_reachable->size());
+        for (size_t i = 0; i < reachable->size(); ++i) {
+            assert(std::isfinite((*reachable)[i].time));
+            assert((*reachable)[i].stop_name == (*expected_reachable)[i].stop_name);
+            assert((*reachable)[i].time == (*expected_reachable)[i].time);
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    TestReachableStopsMatchRoutes();
+    TestNegativeBudget();
+    TestRemovedBusWithHugeBudget();
+    std::cout << "isochrone_test: OK" << std::endl;
+}
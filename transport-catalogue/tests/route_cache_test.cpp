@@ -0,0 +1,127 @@
+// The sharded LRU route cache, alone and behind Router::FindRoute.
+//
+// Build and run from transport-catalogue/, with the sources of the catalogue and
+// the router (no JSON or SVG):
+//   g++ -std=c++17 -O2 -pthread -I. -o route_cache_test tests/route_cache_test.cpp connection_scan_router.cpp distance_table.cpp domain.cpp geo.cpp raptor_router.cpp routing_index.cpp stop_order.cpp transport_catalogue.cpp transport_router.cpp
+//   ./route_cache_test
+
+#include "route_cache.h"
+#include "sample_network.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace transport;
+
+namespace {
+
+using Key = std::pair<graph::VertexId, graph::VertexId>;
+
+// Keys that share a shard with `key`, found through a cache of one entry per
+// shard: inserting a key of the same shard evicts `key`
+std::vector<Key> FindKeysOfSameShard(Key key, size_t count) {
+    std::vector<Key> keys;
+    for (graph::VertexId to = 1000; keys.size() < count; ++to) {
+        RouteCache<int> probe(RouteCache<int>::SHARD_COUNT);
+        int value = 0;
+        probe.Insert(key.first, key.second, 0);
+        probe.Insert(key.first, to, 0);
+        if (!probe.Find(key.first, key.second, value)) {
+            keys.emplace_back(key.first, to);
+        }
+    }
+    return keys;
+}
+
+void TestFindAndInsert() {
+    RouteCache<int> cache(100);
+    int value = 0;
+    assert(!cache.Find(1, 2, value));
+    cache.Insert(1, 2, 12);
+    cache.Insert(2, 1, 21);
+    assert(cache.Find(1, 2, value) && value == 12);
+    assert(cache.Find(2, 1, value) && value == 21);
+    cache.Insert(1, 2, 13);
+    assert(cache.Find(1, 2, value) && value == 13);
+    assert(cache.GetStats().hits == 3 && cache.GetStats().misses == 1);
+
+    cache.Clear();
+    assert(!cache.Find(1, 2, value));
+    assert(cache.GetStats().hits == 3 && cache.GetStats().misses == 2);
+
+    RouteCache<int> disabled(0);
+    assert(!disabled.IsEnabled());
+    disabled.Insert(1, 2, 12);
+    assert(!disabled.Find(1, 2, value));
+}
+
+void TestLeastRecentlyUsedIsEvicted() {
+    const Key a{1, 2};
+    const std::vector<Key> others = FindKeysOfSameShard(a, 2);
+    const Key b = others[0];
+    const Key c = others[1];
+
+    // Two entries per shard
+    RouteCache<int> cache(2 * RouteCache<int>::SHARD_COUNT);
+    int value = 0;
+    cache.Insert(a.first, a.second, 1);
+    cache.Insert(b.first, b.second, 2);
+    assert(cache.Find(a.first, a.second, value));  // b is now the least recently used
+    cache.Insert(c.first, c.second, 3);
+    assert(cache.Find(a.first, a.second, value) && value == 1);
+    assert(!cache.Find(b.first, b.second, value));
+    assert(cache.Find(c.first, c.second, value) && value == 3);
+}
+
+void TestCapacityIsBounded() {
+    RouteCache<int> cache(64);
+    for (graph::VertexId i = 0; i < 1000; ++i) {
+        cache.Insert(i, i + 1, static_cast<int>(i));
+    }
+    size_t kept = 0;
+    int value = 0;
+    for (graph::VertexId i = 0; i < 1000; ++i) {
+        kept += cache.Find(i, i + 1, value);
+    }
+    assert(kept > 0 && kept <= 64);
+}
+
+void TestRouterUsesCache() {
+    Catalogue catalogue;
+    const tests::SampleNetwork network = tests::LoadSampleNetwork(catalogue, 6, 20, 8);
+    const Router router(catalogue, tests::MakeSettings(RouterEngine::DIJKSTRA));
+    std::vector<std::optional<RouteInfo>> first_routes;
+    for (const std::string& to : network.stop_names) {
+        first_routes.push_back(router.FindRoute(network.stop_names[0], to));
+    }
+    const auto misses = router.GetRouteCacheStats().misses;
+    assert(router.GetRouteCacheStats().hits == 0 && misses == network.stop_names.size());
+
+    // Repeated queries are answered from the cache with the same routes
+    for (size_t i = 0; i < network.stop_names.size(); ++i) {
+        const auto route = router.FindRoute(network.stop_names[0], network.stop_names[i]);
+        assert(tests::IsSameRoute(first_routes[i], route));
+        assert(!route || route->edges.size() == first_routes[i]->edges.size());
+    }
+    assert(router.GetRouteCacheStats().hits == network.stop_names.size());
+    assert(router.GetRouteCacheStats().misses == misses);
+
+    RoutingSettings settings = tests::MakeSettings(RouterEngine::DIJKSTRA);
+    settings.route_cache_size = 0;
+    const Router uncached(catalogue, settings);
+    for (size_t i = 0; i < network.stop_names.size(); ++i) {
+        assert(tests::IsSameRoute(first_routes[i], uncached.FindRoute(network.stop_names[0], network.stop_names[i])));
+    }
+    assert(uncached.GetRouteCacheStats().hits == 0);
+}
+
+}  // namespace
+
+int main() {
+    TestFindAndInsert();
+    TestLeastRecentlyUsedIsEvicted();
+    TestCapacityIsBounded();
+    TestRouterUsesCache();
+    std::cout << "route_cache_test: OK" << std::endl;
+}
@@ -0,0 +1,148 @@
+// Every routing engine answers Route queries like the all-pairs router.
+//
+// Build and run from transport-catalogue/, with the sources of the catalogue and
+// the router (no JSON or SVG):
+//   g++ -std=c++17 -O2 -pthread -I. -o router_engines_test tests/router_engines_test.cpp connection_scan_router.cpp distance_table.cpp domain.cpp geo.cpp raptor_router.cpp routing_index.cpp stop_order.cpp transport_catalogue.cpp transport_router.cpp
+//   ./router_engines_test
+
+#include "sample_network.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string_view>
+#include <vector>
+
+using namespace transport;
+
+namespace {
+std::atomic<size_t> allocation_count{0};
+}  // namespace
+
+// Counts the allocations, for the checks of the allocation-free query path
+void* operator new(size_t size) {
+    ++allocation_count;
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+namespace {
+
+void TestEnginesMatchAllPairs() {
+    Catalogue catalogue;
+    const tests::SampleNetwork network = tests::LoadSampleNetwork(catalogue, 1, 60, 25);
+    const Router expected(catalogue, tests::MakeSettings(RouterEngine::ALL_PAIRS));
+    size_t route_count = 0;
+    for (const std::string& from : network.stop_names) {
+        for (const std::string& to : network.stop_names) {
+            route_count += expected.FindRoute(from, to).has_value();
+        }
+    }
+    // Not a trivially disconnected network
+    assert(route_count > network.stop_names.size() * 4);
+
+    for (const RouterEngine engine : {RouterEngine::DIJKSTRA, RouterEngine::CONTRACTION_HIERARCHIES,
+                                      RouterEngine::BLOCKED_ALL_PAIRS, RouterEngine::COMPACT_ALL_PAIRS,
+                                      RouterEngine::RAPTOR, RouterEngine::ALT}) {
+        const Router router(catalogue, tests::MakeSettings(engine));
+        for (const std::string& from : network.stop_names) {
+            for (const std::string& to : network.stop_names) {
+                assert(tests::IsSameRoute(expected.FindRoute(from, to), router.FindRoute(from, to)));
+            }
+        }
+    }
+}
+
+void TestRouteMatrixMatchesRoutes() {
+    Catalogue catalogue;
+    const tests::SampleNetwork network = tests::LoadSampleNetwork(catalogue, 2, 40, 15);
+    const std::vector<std::string_view> stops(network.stop_names.begin(), network.stop_names.end());
+
+    // Against a separate router: the matrix fills the route cache of its own. The
+    // goal-directed engines answer that many targets with one Dijkstra
+    const Router expected(catalogue, tests::MakeSettings(RouterEngine::ALL_PAIRS));
+    for (const RouterEngine engine : {RouterEngine::ALL_PAIRS, RouterEngine::DIJKSTRA, RouterEngine::RAPTOR,
+                                      RouterEngine::CONTRACTION_HIERARCHIES, RouterEngine::ALT}) {
+        const Router router(catalogue, tests::MakeSettings(engine));
+        const Router::RouteMatrix matrix = router.FindRouteMatrix(stops, stops);
+        for (size_t from = 0; from < stops.size(); ++from) {
+            for (size_t to = 0; to < stops.size(); ++to) {
+                assert(tests::IsSameRoute(expected.FindRoute(stops[from], stops[to]), matrix[from][to]));
+            }
+        }
+    }
+}
+
+void TestRouteViewMatchesRoute() {
+    Catalogue catalogue;
+    const tests::SampleNetwork network = tests::LoadSampleNetwork(catalogue, 3, 30, 12);
+    const Router router(catalogue, tests::MakeSettings(RouterEngine::DIJKSTRA));
+    for (const std::string& from : network.stop_names) {
+        for (const std::string& to : network.stop_names) {
+            const auto route = router.FindRoute(from, to);
+            const auto view = router.FindRouteView(from, to);
+            assert(route.has_value() == view.has_value());
+            if (route) {
+                assert(std::abs(route->total_time - view->total_time) < 1e-9);
+                assert(route->edges.size() == view->edges.size());
+            }
+        }
+    }
+}
+
+// Once the per-thread buffers have grown, route views allocate nothing, also on
+// the Dijkstra engine when more sources are queried than its tree cache holds
+void TestWarmRouteViewAllocatesNothing() {
+    Catalogue catalogue;
+    const tests::SampleNetwork network = tests::LoadSampleNetwork(catalogue, 5, 300, 120);
+    std::vector<std::pair<std::string_view, std::string_view>> queries;
+    for (size_t i = 0; i < 200; ++i) {
+        queries.emplace_back(network.stop_names[i * 7 % network.stop_names.size()],
+                             network.stop_names[i * 13 % network.stop_names.size()]);
+    }
+    for (const RouterEngine engine : {RouterEngine::ALL_PAIRS, RouterEngine::DIJKSTRA,
+                                      RouterEngine::CONTRACTION_HIERARCHIES, RouterEngine::BLOCKED_ALL_PAIRS,
+                                      RouterEngine::COMPACT_ALL_PAIRS, RouterEngine::RAPTOR, RouterEngine::ALT}) {
+        const Router router(catalogue, tests::MakeSettings(engine));
+        for (const auto& [from, to] : queries) {
+            router.FindRouteView(from, to);
+        }
+        const size_t count_before = allocation_count;
+        size_t found_count = 0;
+        for (const auto& [from, to] : queries) {
+            found_count += router.FindRouteView(from, to).has_value();
+        }
+        assert(allocation_count == count_before);
+        assert(found_count > queries.size() / 2);
+    }
+}
+
+void TestUnknownStops() {
+    Catalogue catalogue;
+    tests::LoadSampleNetwork(catalogue, 4, 10, 3);
+    const Router router(catalogue, tests::MakeSettings(RouterEngine::DIJKSTRA));
+    assert(!router.FindRoute("Stop 0", "Nowhere"));
+    assert(!router.FindRoute("Nowhere", "Stop 0"));
+}
+
+}  // namespace
+
+int main() {
+    TestEnginesMatchAllPairs();
+    TestRouteMatrixMatchesRoutes();
+    TestRouteViewMatchesRoute();
+    TestWarmRouteViewAllocatesNothing();
+    TestUnknownStops();
+    std::cout << "router_engines_test: OK" << std::endl;
+}
@@ -0,0 +1,266 @@
+// Incremental router updates: after AddBus, RemoveBus and UpdateDistance every
+// engine answers like a router built from scratch on the changed catalogue.
+//
+// Build and run from transport-catalogue/, with the sources of the catalogue and
+// the router (no JSON or SVG):
+//   g++ -std=c++17 -O2 -pthread -I. -o router_update_test tests/router_update_test.cpp connection_scan_router.cpp distance_table.cpp domain.cpp geo.cpp raptor_router.cpp routing_index.cpp stop_order.cpp transport_catalogue.cpp transport_router.cpp
+//   ./router_update_test
+
+#include "alt_router.h"
+#include "dijkstra_router.h"
+#include "graph.h"
+#include "sample_network.h"
+
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace transport;
+
+namespace {
+
+const RouterEngine ENGINES[] = {RouterEngine::ALL_PAIRS, RouterEngine::DIJKSTRA,
+                                RouterEngine::CONTRACTION_HIERARCHIES, RouterEngine::BLOCKED_ALL_PAIRS,
+                                RouterEngine::COMPACT_ALL_PAIRS, RouterEngine::RAPTOR, RouterEngine::ALT};
+
+std::vector<std::pair<graph::VertexId, graph::EdgeId>> GetIncidentEdges(
+    const graph::DirectedWeightedGraph<double>& graph, graph::VertexId vertex) {
+    std::vector<std::pair<graph::VertexId, graph::EdgeId>> edges;
+    for (const auto& edge : graph.GetIncidentEdges(vertex)) {
+        edges.emplace_back(edge.to, edge.id);
+    }
+    return edges;
+}
+
+void TestGraphOverflow() {
+    graph::DirectedWeightedGraph<double> graph(3);
+    graph.AddEdge({0, 1, 1.0});
+    graph.AddEdge({1, 2, 1.0});
+    graph.Freeze();
+
+    // Added to the overflow lists, after the frozen edges of the vertex
+    const graph::EdgeId added = graph.AddEdge({0, 2, 5.0});
+    graph.AddEdge({2, 0, 1.0});
+    assert(graph.IsFrozen() && graph.GetOverflowEdgeCount() == 2);
+    using Edges = std::vector<std::pair<graph::VertexId, graph::EdgeId>>;
+    assert((GetIncidentEdges(graph, 0) == Edges{{1, 0}, {2, added}}));
+    assert((GetIncidentEdges(graph, 1) == Edges{{2, 1}}));
+    assert((GetIncidentEdges(graph, 2) == Edges{{0, 3}}));
+    assert(graph.GetIncidentEdges(0).size() == 2);
+
+    graph.SetEdgeWeight(added, 2.0);
+    for (const auto& edge : graph.GetIncidentEdges(0)) {
+        assert(edge.id != added || edge.weight == 2.0);
+    }
+
+    // Freeze() folds the overflow into the CSR arrays
+    graph.Freeze();
+    assert(graph.GetOverflowEdgeCount() == 0);
+    assert((GetIncidentEdges(graph, 0) == Edges{{1, 0}, {2, added}}));
+    assert((GetIncidentEdges(graph, 2) == Edges{{0, 3}}));
+}
+
+void TestGraphEdgeReuse() {
+    graph::DirectedWeightedGraph<double> graph(3);
+    graph.AddEdge({0, 1, 1.0});
+    graph.AddEdge({0, 2, 1.0});
+    graph.AddEdge({1, 2, 1.0});
+    graph.Freeze();
+    using Edges = std::vector<std::pair<graph::VertexId, graph::EdgeId>>;
+
+    // A removed CSR edge leaves a dead slot, which the edge takes back when reused
+    graph.RemoveEdge(0);
+    assert(graph.GetDeadSlotCount() == 1 && graph.GetEdgeCount() == 3);
+    graph.SetEdge(0, {0, 2, 3.0});
+    assert(graph.GetDeadSlotCount() == 0);
+    assert((GetIncidentEdges(graph, 0) == Edges{{2, 0}, {2, 1}}));
+
+    // An edge moved to another vertex goes to its overflow
+    graph.SetEdge(1, {2, 0, 1.0});
+    assert(graph.GetDeadSlotCount() == 1 && graph.GetOverflowEdgeCount() == 1);
+    assert((GetIncidentEdges(graph, 2) == Edges{{0, 1}}));
+    graph.Freeze();
+    assert(graph.GetDeadSlotCount() == 0 && graph.GetOverflowEdgeCount() == 0);
+    assert((GetIncidentEdges(graph, 0) == Edges{{2, 0}}));
+    assert((GetIncidentEdges(graph, 2) == Edges{{0, 1}}));
+
+    graph.Thaw();
+    graph.RemoveEdge(2);
+    assert(GetIncidentEdges(graph, 1).empty());
+    graph.SetEdge(2, {1, 0, 2.0});
+    assert((GetIncidentEdges(graph, 1) == Edges{{0, 2}}));
+}
+
+// The landmark distances are repaired, not recomputed, so check the routes after
+// several batches of lighter, heavier, added, moved and removed edges
+void TestAltRepair() {
+    constexpr size_t VERTEX_COUNT = 60;
+    std::mt19937 random(11);
+    auto random_vertex = [&random] {
+        return static_cast<graph::VertexId>(random() % VERTEX_COUNT);
+    };
+    auto random_weight = [&random] {
+        return static_cast<double>(1 + random() % 100);
+    };
+    graph::DirectedWeightedGraph<double> graph(VERTEX_COUNT);
+    for (int i = 0; i < 240; ++i) {
+        graph.AddEdge({random_vertex(), random_vertex(), random_weight()});
+    }
+    graph.Freeze();
+    graph::AltRouter<double> router(graph, 4);
+
+    for (int batch = 0; batch < 20; ++batch) {
+        std::vector<graph::EdgeUpdate<double>> updates;
+        for (int i = 0; i < 6; ++i) {
+            const graph::EdgeId edge_id = random() % graph.GetEdgeCount();
+            const graph::Edge<double> old_edge = graph.GetEdge(edge_id);
+            switch (random() % 4) {
+            case 0:
+                graph.SetEdge(edge_id, {old_edge.from, old_edge.to, random_weight()});
+                break;
+            case 1:
+                graph.SetEdge(edge_id, {random_vertex(), random_vertex(), random_weight()});
+                break;
+            case 2:
+                graph.RemoveEdge(edge_id);
+                break;
+            default:
+                const graph::Edge<double> edge{random_vertex(), random_vertex(), random_weight()};
+                updates.push_back({graph.AddEdge(edge), {edge.from, edge.to, graph::WeightTraits<double>::INFINITE_WEIGHT}});
+                continue;
+            }
+            updates.push_back({edge_id, old_edge});
+        }
+        router.Repair(updates);
+
+        const graph::DijkstraRouter<double> expected(graph);
+        for (graph::VertexId from = 0; from < VERTEX_COUNT; ++from) {
+            for (graph::VertexId to = 0; to < VERTEX_COUNT; ++to) {
+                const auto expected_route = expected.BuildRoute(from, to);
+                const auto route = router.BuildRoute(from, to);
+                assert(expected_route.has_value() == route.has_value());
+                assert(!route || route->weight == expected_route->weight);
+            }
+        }
+    }
+}
+
+// The distance may also change buses the routers already have
+void SetDistance(Catalogue& catalogue, const Stop* from, const Stop* to, int distance,
+                 const std::vector<std::unique_ptr<Router>>& routers) {
+    catalogue.SetDistance(from, to, distance);
+    for (const auto& router : routers) {
+        router->UpdateDistance(catalogue, from->name, to->name);
+    }
+}
+
+void CheckAgainstFreshRouter(const Catalogue& catalogue, const tests::SampleNetwork& network,
+                             const std::vector<std::unique_ptr<Router>>& routers) {
+    const Router expected(catalogue, tests::MakeSettings(RouterEngine::ALL_PAIRS));
+    for (const std::string& from : network.stop_names) {
+        for (const std::string& to : network.stop_names) {
+            const auto expected_route = expected.FindRoute(from, to);
+            for (const auto& router : routers) {
+                assert(tests::IsSameRoute(expected_route, router->FindRoute(from, to)));
+            }
+        }
+    }
+}
+
+void TestUpdates() {
+    Catalogue catalogue;
+    tests::SampleNetwork network = tests::LoadSampleNetwork(catalogue, 5, 40, 8);
+    std::vector<std::unique_ptr<Router>> routers;
+    for (const RouterEngine engine : ENGINES) {
+        routers.push_back(std::make_unique<Router>(catalogue, tests::MakeSettings(engine)));
+    }
+
+    // A bulk-loaded catalogue is frozen, the updates need it writable
+    catalogue.Thaw();
+    const Stop* first = catalogue.FindStop(network.stop_names[0]);
+    const Stop* last = catalogue.FindStop(network.stop_names.back());
+    SetDistance(catalogue, first, last, 100, routers);
+    catalogue.AddRoute("express", {first, last}, false);
+    for (const auto& router : routers) {
+        router->AddBus(catalogue, "express");
+        const auto route = router->FindRoute(first->name, last->name);
+        assert(route && route->edges.size() == 2 && route->edges[1].bus_name == "express");
+    }
+    network.bus_numbers.push_back("express");
+    CheckAgainstFreshRouter(catalogue, network, routers);
+
+    // Enough new buses for the graph to be frozen again on the way
+    std::mt19937 random(7);
+    for (int i = 0; i < 12; ++i) {
+        const std::string number = "new " + std::to_string(i);
+        std::vector<const Stop*> stops;
+        for (size_t j = 0; j < 5; ++j) {
+            const Stop* stop = catalogue.FindStop(network.stop_names[random() % network.stop_names.size()]);
+            if (stops.empty() || stops.back() != stop) {
+                if (!stops.empty()) {
+                    SetDistance(catalogue, stops.back(), stop, 200 + static_cast<int>(random() % 2000), routers);
+                }
+                stops.push_back(stop);
+            }
+        }
+        catalogue.AddRoute(number, stops, false);
+        for (const auto& router : routers) {
+            router->AddBus(catalogue, number);
+        }
+        network.bus_numbers.push_back(number);
+    }
+    CheckAgainstFreshRouter(catalogue, network, routers);
+
+    SetDistance(catalogue, first, last, 5000, routers);
+    CheckAgainstFreshRouter(catalogue, network, routers);
+
+    catalogue.RemoveRoute("express");
+    for (const auto& router : routers) {
+        router->RemoveBus("express");
+    }
+    CheckAgainstFreshRouter(catalogue, network, routers);
+
+    // A replaced bus keeps its edges with as many stops, and otherwise takes the
+    // free edges of removed buses before new ones are added
+    const Bus* changed = catalogue.FindRoute("new 0");
+    std::vector<const Stop*> stops(changed->stops.rbegin(), changed->stops.rend());
+    catalogue.AddRoute("new 0", stops, false);
+    for (const auto& router : routers) {
+        router->AddBus(catalogue, "new 0");
+    }
+    CheckAgainstFreshRouter(catalogue, network, routers);
+    stops.pop_back();
+    catalogue.AddRoute("new 0", stops, false);
+    for (const auto& router : routers) {
+        router->AddBus(catalogue, "new 0");
+    }
+    CheckAgainstFreshRouter(catalogue, network, routers);
+    catalogue.AddRoute("express", {first, last}, false);
+    for (const auto& router : routers) {
+        router->AddBus(catalogue, "express");
+    }
+    network.bus_numbers.push_back("express");
+    CheckAgainstFreshRouter(catalogue, network, routers);
+    // A distance changed on a bus the routers have not been given yet leaves the
+    // edges of the other buses alone
+    stops.assign(catalogue.FindRoute("new 1")->stops.begin(), catalogue.FindRoute("new 1")->stops.end());
+    stops.push_back(stops.back() == first ? last : first);
+    catalogue.AddRoute("new 1", stops, false);
+    SetDistance(catalogue, stops[stops.size() - 2], stops.back(), 50, routers);
+    for (const auto& router : routers) {
+        router->AddBus(catalogue, "new 1");
+    }
+    CheckAgainstFreshRouter(catalogue, network, routers);
+}
+
+}  // namespace
+
+int main() {
+    TestGraphOverflow();
+    TestGraphEdgeReuse();
+    TestAltRepair();
+    TestUpdates();
+    std::cout << "router_update_test: OK" << std::endl;
+}
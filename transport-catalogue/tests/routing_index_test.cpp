@@ -0,0 +1,137 @@
+// An index written by one process is reused by the next one, for every engine
+// that builds a graph, and is rewritten when the network changes. A loaded
+// router, which borrows the mapped arrays, can still be updated.
+//
+// The test runs itself as the writing process, so the names of the catalogue
+// live at other addresses than in the reading one.
+//
+// Build and run from transport-catalogue/, with the sources of the catalogue and
+// the router (no JSON or SVG):
+//   g++ -std=c++17 -O2 -pthread -I. -o routing_index_test tests/routing_index_test.cpp connection_scan_router.cpp distance_table.cpp domain.cpp geo.cpp raptor_router.cpp routing_index.cpp stop_order.cpp transport_catalogue.cpp transport_router.cpp
+//   ./routing_index_test
+
+#include "sample_network.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace transport;
+
+namespace {
+
+constexpr size_t STOP_COUNT = 50;
+constexpr size_t BUS_COUNT = 20;
+
+// Builds the router of the sample network with the given seed and index file
+void RunBuilder(RouterEngine engine, unsigned seed, const std::string& index_file) {
+    Catalogue catalogue;
+    tests::LoadSampleNetwork(catalogue, seed, STOP_COUNT, BUS_COUNT);
+    RoutingSettings settings = tests::MakeSettings(engine);
+    settings.index_file = index_file;
+    const Router router(catalogue, settings);
+}
+
+// Inode of the file, 0 if it is missing. Saving goes through a rename, so a
+// rewritten index gets a new inode
+ino_t GetInode(const std::string& path) {
+    struct stat file_stat{};
+    return ::stat(path.c_str(), &file_stat) == 0 ? file_stat.st_ino : 0;
+}
+
+void RunBuilderProcess(const std::string& program, RouterEngine engine, unsigned seed,
+                       const std::string& index_file) {
+    const std::string command = "'" + program + "' --build " + std::to_string(static_cast<int>(engine)) + " "
+                                + std::to_string(seed) + " '" + index_file + "'";
+    const int status = std::system(command.c_str());
+    assert(status == 0);
+}
+
+void TestIndexIsReused(const std::string& program, RouterEngine engine) {
+    const std::string index_file = "/tmp/routing_index_test_" + std::to_string(::getpid()) + ".idx";
+    std::remove(index_file.c_str());
+
+    RunBuilderProcess(program, engine, 1, index_file);
+    const ino_t written_inode = GetInode(index_file);
+    assert(written_inode != 0);
+
+    // The same network in another process: the index is loaded, not rewritten
+    RunBuilderProcess(program, engine, 1, index_file);
+    assert(GetInode(index_file) == written_inode);
+
+    // Here too, and the loaded router answers like a freshly built one
+    Catalogue catalogue;
+    const tests::SampleNetwork network = tests::LoadSampleNetwork(catalogue, 1, STOP_COUNT, BUS_COUNT);
+    RoutingSettings settings = tests::MakeSettings(engine);
+    settings.index_file = index_file;
+    const Router loaded(catalogue, settings);
+    assert(GetInode(index_file) == written_inode);
+    const Router built(catalogue, tests::MakeSettings(engine));
+    for (const std::string& from : network.stop_names) {
+        for (const std::string& to : network.stop_names) {
+            assert(tests::IsSameRoute(built.FindRoute(from, to), loaded.FindRoute(from, to)));
+        }
+    }
+
+    // Another network does not match the index, which is rebuilt
+    RunBuilderProcess(program, engine, 2, index_file);
+    assert(GetInode(index_file) != written_inode);
+
+    std::remove(index_file.c_str());
+}
+
+// The stop indices of the file follow the vertex order, which LoadIndex must use
+// as well; the first update copies the borrowed graph, metadata and table
+void TestLoadedIndexIsUpdated(RouterEngine engine, VertexOrder order) {
+    const std::string index_file = "/tmp/routing_index_test_" + std::to_string(::getpid()) + ".idx";
+    std::remove(index_file.c_str());
+
+    Catalogue catalogue;
+    const tests::SampleNetwork network = tests::LoadSampleNetwork(catalogue, 3, STOP_COUNT, BUS_COUNT);
+    RoutingSettings settings = tests::MakeSettings(engine);
+    settings.vertex_order = order;
+    settings.index_file = index_file;
+    {
+        const Router writer(catalogue, settings);
+    }
+    const ino_t written_inode = GetInode(index_file);
+    Router loaded(catalogue, settings);
+    assert(written_inode != 0 && GetInode(index_file) == written_inode);
+
+    catalogue.Thaw();
+    const Bus* bus = catalogue.FindRoute(network.bus_numbers[1]);
+    catalogue.SetDistance(bus->stops[0], bus->stops[1], 100);
+    loaded.UpdateDistance(catalogue, bus->stops[0]->name, bus->stops[1]->name);
+    catalogue.RemoveRoute(network.bus_numbers[0]);
+    loaded.RemoveBus(network.bus_numbers[0]);
+
+    settings.index_file.clear();
+    const Router built(catalogue, settings);
+    for (const std::string& from : network.stop_names) {
+        for (const std::string& to : network.stop_names) {
+            assert(tests::IsSameRoute(built.FindRoute(from, to), loaded.FindRoute(from, to)));
+        }
+    }
+    std::remove(index_file.c_str());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc == 5 && std::string(argv[1]) == "--build") {
+        RunBuilder(static_cast<RouterEngine>(std::atoi(argv[2])), static_cast<unsigned>(std::atoi(argv[3])), argv[4]);
+        return 0;
+    }
+
+    for (const RouterEngine engine : {RouterEngine::ALL_PAIRS, RouterEngine::DIJKSTRA,
+                                      RouterEngine::CONTRACTION_HIERARCHIES, RouterEngine::BLOCKED_ALL_PAIRS,
+                                      RouterEngine::COMPACT_ALL_PAIRS, RouterEngine::ALT}) {
+        TestIndexIsReused(argv[0], engine);
+        TestLoadedIndexIsUpdated(engine, VertexOrder::RCM);
+    }
+    std::cout << "routing_index_test: OK" << std::endl;
+}
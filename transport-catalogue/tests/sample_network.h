@@ -0,0 +1,88 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <cassert>
+#include <cmath>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace tests {
+
+struct SampleNetwork {
+    std::vector<std::string> stop_names;
+    std::vector<std::string> bus_numbers;
+};
+
+// Deterministic network of stop_count stops and bus_count buses, bulk-loaded
+// into the catalogue and frozen. Every bus rides between stops with a road
+// distance set in at least one direction
+inline SampleNetwork LoadSampleNetwork(transport::Catalogue& catalogue, unsigned seed,
+                                       size_t stop_count, size_t bus_count) {
+    std::mt19937 random(seed);
+    SampleNetwork network;
+    for (size_t i = 0; i < stop_count; ++i) {
+        network.stop_names.push_back("Stop " + std::to_string(i));
+    }
+    for (size_t i = 0; i < bus_count; ++i) {
+        network.bus_numbers.push_back(std::to_string(i));
+    }
+
+    catalogue.Reserve(stop_count, bus_count, bus_count * 8);
+    std::uniform_real_distribution<double> offset(0.0, 0.1);
+    for (const std::string& name : network.stop_names) {
+        catalogue.LoadStop(name, {55.6 + offset(random), 37.5 + offset(random)});
+    }
+    for (const std::string& number : network.bus_numbers) {
+        const bool is_circle = random() % 2 == 0;
+        std::vector<std::string_view> stops;
+        const size_t length = 2 + random() % 6;
+        while (stops.size() < length) {
+            const std::string_view stop = network.stop_names[random() % stop_count];
+            if (stops.empty() || stops.back() != stop) {
+                stops.push_back(stop);
+            }
+        }
+        if (is_circle) {
+            stops.push_back(stops.front());
+        }
+        for (size_t i = 1; i < stops.size(); ++i) {
+            catalogue.LoadDistance(stops[i - 1], stops[i], 300 + static_cast<int>(random() % 3000));
+        }
+        catalogue.LoadRoute(number, std::move(stops), is_circle);
+    }
+    catalogue.Freeze();
+    return network;
+}
+
+inline transport::RoutingSettings MakeSettings(transport::RouterEngine engine) {
+    transport::RoutingSettings settings;
+    settings.bus_wait_time = 6;
+    settings.bus_velocity = 40.0;
+    settings.engine = engine;
+    return settings;
+}
+
+// Routes may differ between engines when several have the same time, so only
+// the total times are compared, and the items of each route must add up to it
+inline bool IsSameRoute(const std::optional<transport::RouteInfo>& expected,
+                        const std::optional<transport::RouteInfo>& actual) {
+    if (expected.has_value() != actual.has_value()) {
+        return false;
+    }
+    if (!expected) {
+        return true;
+    }
+    double items_time = 0.0;
+    for (const auto& item : actual->edges) {
+        items_time += item.time;
+    }
+    const double tolerance = 1e-4 * (1.0 + expected->total_time);
+    return std::abs(expected->total_time - actual->total_time) < tolerance
+           && std::abs(items_time - actual->total_time) < tolerance;
+}
+
+}  // namespace tests
@@ -0,0 +1,70 @@
+// Every vertex order numbers each stop once, always the same way for the same
+// catalogue, and does not change the routes.
+//
+// Build and run from transport-catalogue/, with the sources of the catalogue and
+// the router (no JSON or SVG):
+//   g++ -std=c++17 -O2 -pthread -I. -o stop_order_test tests/stop_order_test.cpp connection_scan_router.cpp distance_table.cpp domain.cpp geo.cpp raptor_router.cpp routing_index.cpp stop_order.cpp transport_catalogue.cpp transport_router.cpp
+//   ./stop_order_test
+
+#include "sample_network.h"
+#include "stop_order.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace transport;
+
+namespace {
+
+const VertexOrder ORDERS[] = {VertexOrder::NAME, VertexOrder::BFS, VertexOrder::RCM, VertexOrder::HILBERT};
+
+void TestOrdersArePermutations() {
+    Catalogue catalogue;
+    tests::LoadSampleNetwork(catalogue, 9, 80, 30);
+    std::vector<const Stop*> all_stops = OrderStops(catalogue, VertexOrder::NAME);
+    std::sort(all_stops.begin(), all_stops.end());
+
+    for (const VertexOrder order : ORDERS) {
+        const std::vector<const Stop*> stops = OrderStops(catalogue, order);
+        assert(OrderStops(catalogue, order) == stops);
+        std::vector<const Stop*> sorted_stops = stops;
+        std::sort(sorted_stops.begin(), sorted_stops.end());
+        assert(sorted_stops == all_stops);
+    }
+
+    const std::vector<const Stop*> by_name = OrderStops(catalogue, VertexOrder::NAME);
+    assert(std::is_sorted(by_name.begin(), by_name.end(), [](const Stop* lhs, const Stop* rhs) {
+        return lhs->name < rhs->name;
+    }));
+    assert(OrderStops(Catalogue{}, VertexOrder::RCM).empty());
+}
+
+void TestRoutesDoNotDependOnOrder() {
+    Catalogue catalogue;
+    const tests::SampleNetwork network = tests::LoadSampleNetwork(catalogue, 10, 50, 20);
+    const Router expected(catalogue, tests::MakeSettings(RouterEngine::ALL_PAIRS));
+
+    for (const VertexOrder order : ORDERS) {
+        for (const RouterEngine engine : {RouterEngine::ALL_PAIRS, RouterEngine::DIJKSTRA,
+                                          RouterEngine::CONTRACTION_HIERARCHIES}) {
+            RoutingSettings settings = tests::MakeSettings(engine);
+            settings.vertex_order = order;
+            const Router router(catalogue, settings);
+            for (const std::string& from : network.stop_names) {
+                for (const std::string& to : network.stop_names) {
+                    assert(tests::IsSameRoute(expected.FindRoute(from, to), router.FindRoute(from, to)));
+                }
+            }
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    TestOrdersArePermutations();
+    TestRoutesDoNotDependOnOrder();
+    std::cout << "stop_order_test: OK" << std::endl;
+}
@@ -0,0 +1,145 @@
+// Routes with a departure time: the timetable is only built when some bus has
+// departures, is created by AddBus when the first such bus arrives, and answers
+// with the real waits whatever the routing engine.
+//
+// Build and run from transport-catalogue/, with the sources of the catalogue and
+// the router (no JSON or SVG):
+//   g++ -std=c++17 -O2 -pthread -I. -o timetable_test tests/timetable_test.cpp connection_scan_router.cpp distance_table.cpp domain.cpp geo.cpp raptor_router.cpp routing_index.cpp stop_order.cpp transport_catalogue.cpp transport_router.cpp
+//   ./timetable_test
+
+#include "sample_network.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+using namespace transport;
+
+namespace {
+
+bool IsNear(double lhs, double rhs) {
+    return std::abs(lhs - rhs) < 1e-6;
+}
+
+// A - B - C, 2 km apart: 3 minutes a leg at 40 km/h
+void LoadLine(Catalogue& catalogue, std::vector<double> departures) {
+    catalogue.LoadStop("A", {55.60, 37.50});
+    catalogue.LoadStop("B", {55.61, 37.51});
+    catalogue.LoadStop("C", {55.62, 37.52});
+    catalogue.LoadDistance("A", "B", 2000);
+    catalogue.LoadDistance("B", "C", 2000);
+    catalogue.LoadRoute("1", {"A", "B", "C"}, false, std::move(departures));
+    catalogue.Freeze();
+}
+
+void TestDepartures() {
+    Catalogue catalogue;
+    LoadLine(catalogue, {600.0, 660.0});
+    for (const RouterEngine engine : {RouterEngine::DIJKSTRA, RouterEngine::RAPTOR, RouterEngine::CONNECTION_SCAN}) {
+        const Router router(catalogue, tests::MakeSettings(engine));
+        // The 600 trip has left A, the next one leaves at 660 and reaches C at 666
+        const auto route = router.FindRoute("A", "C", 610.0);
+        assert(route && IsNear(route->total_time, 56.0));
+        // The 600 trip passes B at 603
+        const auto from_b = router.FindRoute("B", "C", 600.0);
+        assert(from_b && IsNear(from_b->total_time, 6.0));
+        // No trip leaves after the last one
+        assert(!router.FindRoute("A", "C", 700.0));
+        assert(!router.FindRoute("A", "Nowhere", 600.0));
+    }
+
+    // Without a departure time only the graph and RAPTOR engines find routes, the
+    // timetables alone refuse the queries
+    assert(Router(catalogue, tests::MakeSettings(RouterEngine::DIJKSTRA)).FindRoute("A", "C"));
+    const Router timetable_router(catalogue, tests::MakeSettings(RouterEngine::CONNECTION_SCAN));
+    auto throws_logic_error = [](auto query) {
+        try {
+            query();
+        } catch (const std::logic_error&) {
+            return true;
+        }
+        return false;
+    };
+    assert(throws_logic_error([&] { timetable_router.FindRoute("A", "C"); }));
+    assert(throws_logic_error([&] { timetable_router.FindRouteMatrix({"A"}, {"C"}); }));
+    assert(throws_logic_error([&] { timetable_router.FindReachableStops("A", 60.0); }));
+}
+
+void TestTimetableCreatedByAddBus() {
+    Catalogue catalogue;
+    LoadLine(catalogue, {});
+    Router router(catalogue, tests::MakeSettings(RouterEngine::DIJKSTRA));
+    assert(router.FindRoute("A", "C"));
+    assert(!router.FindRoute("A", "C", 600.0));
+
+    catalogue.Thaw();
+    const Stop* a = catalogue.FindStop("A");
+    const Stop* c = catalogue.FindStop("C");
+    catalogue.SetDistance(a, c, 6000);
+    catalogue.AddRoute("2", {a, c}, false, {630.0});
+    router.AddBus(catalogue, "2");
+    // 630 + 6000 m at 40 km/h
+    const auto route = router.FindRoute("A", "C", 600.0);
+    assert(route && IsNear(route->total_time, 39.0));
+
+    router.RemoveBus("2");
+    assert(!router.FindRoute("A", "C", 600.0));
+}
+
+// A distance change re-adds the trips of the buses through the two stops, but
+// not of a bus removed from the router only
+void TestUpdateDistanceSkipsRemovedBus() {
+    Catalogue catalogue;
+    LoadLine(catalogue, {600.0});
+    Router router(catalogue, tests::MakeSettings(RouterEngine::DIJKSTRA));
+    assert(router.FindRoute("A", "B", 590.0));
+    router.RemoveBus("1");
+    assert(!router.FindRoute("A", "B", 590.0) && !router.FindRoute("A", "B"));
+
+    catalogue.Thaw();
+    catalogue.SetDistance(catalogue.FindStop("A"), catalogue.FindStop("B"), 4000);
+    router.UpdateDistance(catalogue, "A", "B");
+    assert(!router.FindRoute("A", "B", 590.0) && !router.FindRoute("A", "B"));
+}
+
+// Removing a bus renumbers the trips of the later ones, which still answer
+void TestTripsRenumberedOnRemove() {
+    Catalogue catalogue;
+    LoadLine(catalogue, {600.0, 660.0});
+    catalogue.Thaw();
+    const Stop* a = catalogue.FindStop("A");
+    const Stop* b = catalogue.FindStop("B");
+    const Stop* c = catalogue.FindStop("C");
+    catalogue.AddRoute("2", {b, c}, false, {700.0});
+    Router router(catalogue, tests::MakeSettings(RouterEngine::CONNECTION_SCAN));
+
+    // Replaced again and again, as by distance changes, then removed
+    for (int i = 0; i < 3; ++i) {
+        catalogue.SetDistance(a, b, 2000 + 100 * i);
+        router.UpdateDistance(catalogue, "A", "B");
+    }
+    router.RemoveBus("1");
+    assert(!router.FindRoute("A", "B", 590.0));
+    // Only bus 2 is left: B 700 -> C 703
+    const auto route = router.FindRoute("B", "C", 690.0);
+    assert(route && IsNear(route->total_time, 13.0) && route->edges.size() == 2);
+    assert(route->edges[1].bus_name == "2");
+
+    // The timetable does not grow with the updates
+    ConnectionScanRouter timetable(catalogue, 40.0);
+    assert(timetable.GetTripCount() == 3);
+    for (int i = 0; i < 100; ++i) {
+        timetable.AddBus(catalogue, catalogue.FindRoute("1"));
+    }
+    assert(timetable.GetTripCount() == 3);
+}
+
+}  // namespace
+
+int main() {
+    TestDepartures();
+    TestTimetableCreatedByAddBus();
+    TestUpdateDistanceSkipsRemovedBus();
+    TestTripsRenumberedOnRemove();
+    std::cout << "timetable_test: OK" << std::endl;
+}
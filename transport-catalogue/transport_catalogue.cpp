@@ -1,22 +1,299 @@
 #include "transport_catalogue.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
 
 namespace transport {
 
-void Catalogue::AddStop(std::string_view stop_name, const geo::Coordinates coordinates) {
-    all_stops_.push_back({ std::string(stop_name), coordinates, {} });
-    stopname_to_stop_[all_stops_.back().name] = &all_stops_.back();
+namespace {
+// Below this many buses the stats are computed on the calling thread
+constexpr size_t PARALLEL_STAT_MIN_BUSES = 256;
+
+bool IsBusNumberLess(const Bus* lhs, const Bus* rhs) {
+    return lhs->number < rhs->number;
+}
+
+template <typename T>
+using SortedIndex = std::vector<std::pair<std::string_view, T>>;
+
+template <typename T>
+auto FindInIndex(SortedIndex<T>& index, std::string_view name) {
+    return std::lower_bound(index.begin(), index.end(), name, [](const auto& entry, std::string_view value) {
+        return entry.first < value;
+    });
+}
+
+// An entry of the same name is replaced
+template <typename T>
+void InsertToIndex(SortedIndex<T>& index, std::string_view name, T value) {
+    const auto it = FindInIndex(index, name);
+    if (it != index.end() && it->first == name) {
+        it->second = value;
+    } else {
+        index.emplace(it, name, value);
+    }
+}
+
+template <typename T>
+void EraseFromIndex(SortedIndex<T>& index, std::string_view name) {
+    const auto it = FindInIndex(index, name);
+    if (it != index.end() && it->first == name) {
+        index.erase(it);
+    }
+}
+
+// Merges entries sorted by name, each name once, in one linear pass; an added
+// entry replaces one of the same name
+template <typename T>
+void MergeToIndex(SortedIndex<T>& index, const SortedIndex<T>& added) {
+    SortedIndex<T> merged;
+    merged.reserve(index.size() + added.size());
+    auto it = index.begin();
+    for (const auto& entry : added) {
+        for (; it != index.end() && it->first < entry.first; ++it) {
+            merged.push_back(*it);
+        }
+        if (it != index.end() && it->first == entry.first) {
+            ++it;
+        }
+        merged.push_back(entry);
+    }
+    merged.insert(merged.end(), it, index.end());
+    index.swap(merged);
+}
+} // namespace
+
+void Catalogue::Reserve(size_t stop_count, size_t bus_count, size_t distance_count) {
+    CheckNotFrozen();
+    loaded_stops_.reserve(loaded_stops_.size() + stop_count);
+    loaded_routes_.reserve(loaded_routes_.size() + bus_count);
+    loaded_distances_.reserve(loaded_distances_.size() + distance_count);
+    names_.Reserve(stop_count + bus_count);
+    stopname_to_stop_.reserve(stopname_to_stop_.size() + stop_count);
+    busname_to_bus_.reserve(busname_to_bus_.size() + bus_count);
+    distances_.Reserve(distance_count);
+}
+
+void Catalogue::LoadStop(std::string_view stop_name, geo::Coordinates coordinates) {
+    CheckNotFrozen();
+    loaded_stops_.push_back(&EmplaceStop(stop_name, coordinates));
+}
+
+void Catalogue::LoadDistance(std::string_view from_stop, std::string_view to_stop, int distance) {
+    CheckNotFrozen();
+    loaded_distances_.push_back({ from_stop, to_stop, distance });
+}
+
+void Catalogue::LoadRoute(std::string_view bus_number, std::vector<std::string_view> stop_names, bool is_circle,
+                          std::vector<double> departures) {
+    CheckNotFrozen();
+    loaded_routes_.push_back({ bus_number, std::move(stop_names), is_circle, std::move(departures) });
+}
+
+void Catalogue::Freeze() {
+    if (is_frozen_) return;
+
+    // Stops first, the other records refer to them by name
+    for (Stop* stop : loaded_stops_) {
+        stopname_to_stop_[stop->name] = stop;
+    }
+    // A stop loaded twice keeps its last record
+    SortedIndex<const Stop*> new_stops;
+    new_stops.reserve(loaded_stops_.size());
+    for (const Stop* stop : loaded_stops_) {
+        if (stopname_to_stop_.at(stop->name) == stop) {
+            new_stops.emplace_back(stop->name, stop);
+        }
+    }
+    std::sort(new_stops.begin(), new_stops.end());
+    MergeToIndex(sorted_stops_, new_stops);
+
+    // Distances and stops of a route naming an unknown stop are skipped
+    for (const auto& record : loaded_distances_) {
+        const Stop* from = FindStop(record.from);
+        const Stop* to = FindStop(record.to);
+        if (from && to) {
+            distances_.Set(from->id, to->id, record.distance);
+        }
+    }
+
+    std::vector<const Bus*> new_buses;
+    new_buses.reserve(loaded_routes_.size());
+    for (auto& record : loaded_routes_) {
+        std::vector<const Stop*> stops;
+        stops.reserve(record.stop_names.size());
+        for (const std::string_view stop_name : record.stop_names) {
+            if (const Stop* stop = FindStop(stop_name)) {
+                stops.push_back(stop);
+            }
+        }
+        RemoveRoute(record.number);
+        if (stops.empty()) {
+            continue;
+        }
+        std::sort(record.departures.begin(), record.departures.end());
+        all_buses_.push_back({ names_.Intern(record.number),
+                               std::pmr::vector<const Stop*>(stops.begin(), stops.end(), &arena_),
+                               record.is_circle,
+                               std::pmr::vector<double>(record.departures.begin(), record.departures.end(), &arena_),
+                               BusStat{} });
+        busname_to_bus_[all_buses_.back().number] = &all_buses_.back();
+        new_buses.push_back(&all_buses_.back());
+    }
+    // A bus loaded twice keeps its last record, and none if that has no known stops
+    new_buses.erase(std::remove_if(new_buses.begin(), new_buses.end(), [this](const Bus* bus) {
+                        const auto it = busname_to_bus_.find(bus->number);
+                        return it == busname_to_bus_.end() || it->second != bus;
+                    }),
+                    new_buses.end());
+    // The bus lists of the stops are built from one array of (stop, bus) pairs
+    // sorted by stop and bus number, so each list is sized exactly once: the arena
+    // never gets the memory of a grown list back
+    std::sort(new_buses.begin(), new_buses.end(), IsBusNumberLess);
+    SortedIndex<const Bus*> new_bus_entries;
+    new_bus_entries.reserve(new_buses.size());
+    std::vector<std::pair<const Stop*, uint32_t>> stop_buses;
+    for (uint32_t rank = 0; rank < new_buses.size(); ++rank) {
+        const Bus* bus = new_buses[rank];
+        new_bus_entries.emplace_back(bus->number, bus);
+        for (const Stop* route_stop : bus->stops) {
+            stop_buses.emplace_back(route_stop, rank);
+        }
+    }
+    MergeToIndex(sorted_buses_, new_bus_entries);
+    std::sort(stop_buses.begin(), stop_buses.end());
+    stop_buses.erase(std::unique(stop_buses.begin(), stop_buses.end()), stop_buses.end());
+    for (auto group = stop_buses.begin(); group != stop_buses.end();) {
+        const auto group_end = std::find_if(group, stop_buses.end(), [group](const auto& entry) {
+            return entry.first != group->first;
+        });
+        auto& buses = stopname_to_stop_.at(group->first->name)->buses_by_stop;
+        const size_t old_size = buses.size();
+        buses.reserve(old_size + (group_end - group));
+        for (auto it = group; it != group_end; ++it) {
+            buses.push_back(new_buses[it->second]);
+        }
+        // Buses added before the loaded ones may come later in number order
+        if (old_size > 0) {
+            std::inplace_merge(buses.begin(), buses.begin() + old_size, buses.end(), IsBusNumberLess);
+        }
+        group = group_end;
+    }
+
+    // Loaded distances may also change the stats of buses added before. Each task
+    // writes only the stat of its bus
+    std::vector<Bus*> buses;
+    buses.reserve(busname_to_bus_.size());
+    for (const auto& [number, bus] : busname_to_bus_) {
+        buses.push_back(bus);
+    }
+    parallel::Run(buses.size() < PARALLEL_STAT_MIN_BUSES ? 1 : 0, buses.size(), [this, &buses](size_t bus) {
+        buses[bus]->stat = ComputeBusStat(*buses[bus]);
+    });
+
+    std::vector<Stop*>().swap(loaded_stops_);
+    std::vector<RouteRecord>().swap(loaded_routes_);
+    std::vector<DistanceRecord>().swap(loaded_distances_);
+    is_frozen_ = true;
 }
 
-void Catalogue::AddRoute(std::string_view bus_number, const std::vector<const Stop*> stops, bool is_circle) {
-    all_buses_.push_back({ std::string(bus_number), stops, is_circle });
-    busname_to_bus_[all_buses_.back().number] = &all_buses_.back();
-    for (const auto& route_stop : stops) {
-        for (auto& stop_ : all_stops_) {
-            if (stop_.name == route_stop->name) stop_.buses_by_stop.insert(std::string(bus_number));
+void Catalogue::Thaw() {
+    is_frozen_ = false;
+}
+
+bool Catalogue::IsFrozen() const {
+    return is_frozen_;
+}
+
+void Catalogue::CheckNotFrozen() const {
+    if (is_frozen_) {
+        throw std::logic_error("Catalogue is frozen");
+    }
+}
+
+Stop& Catalogue::EmplaceStop(std::string_view stop_name, geo::Coordinates coordinates) {
+    const uint32_t id = static_cast<uint32_t>(all_stops_.size());
+    all_stops_.push_back({ names_.Intern(stop_name), coordinates, std::pmr::vector<const Bus*>(&arena_), id });
+    return all_stops_.back();
+}
+
+void Catalogue::IndexBusStops(const Bus* bus) {
+    for (const Stop* route_stop : bus->stops) {
+        auto& buses = stopname_to_stop_.at(route_stop->name)->buses_by_stop;
+        const auto it = std::lower_bound(buses.begin(), buses.end(), bus, IsBusNumberLess);
+        if (it == buses.end() || *it != bus) {
+            buses.insert(it, bus);
         }
     }
 }
 
+BusStat Catalogue::ComputeBusStat(const Bus& bus) const {
+    BusStat stat;
+    stat.stops_count = bus.is_circle ? bus.stops.size() : bus.stops.size() * 2 - 1;
+
+    std::vector<uint32_t> stop_ids;
+    stop_ids.reserve(bus.stops.size());
+    for (const Stop* stop : bus.stops) {
+        stop_ids.push_back(stop->id);
+    }
+    std::sort(stop_ids.begin(), stop_ids.end());
+    stat.unique_stops_count = std::unique(stop_ids.begin(), stop_ids.end()) - stop_ids.begin();
+
+    double geographic_length = 0.0;
+    stat.route_length = 0;
+    for (size_t i = 0; i + 1 < bus.stops.size(); ++i) {
+        const Stop* from = bus.stops[i];
+        const Stop* to = bus.stops[i + 1];
+        const double direct_distance = geo::ComputeDistance(from->coordinates, to->coordinates);
+        if (bus.is_circle) {
+            stat.route_length += GetDistance(from, to);
+            geographic_length += direct_distance;
+        } else {
+            stat.route_length += GetDistance(from, to) + GetDistance(to, from);
+            geographic_length += direct_distance * 2;
+        }
+    }
+    stat.curvature = stat.route_length / geographic_length;
+    return stat;
+}
+
+void Catalogue::AddStop(std::string_view stop_name, const geo::Coordinates coordinates) {
+    CheckNotFrozen();
+    Stop& stop = EmplaceStop(stop_name, coordinates);
+    stopname_to_stop_[stop.name] = &stop;
+    InsertToIndex<const Stop*>(sorted_stops_, stop.name, &stop);
+}
+
+void Catalogue::AddRoute(std::string_view bus_number, const std::vector<const Stop*> stops, bool is_circle,
+                         std::vector<double> departures) {
+    // A bus added again replaces the old one, also in the stops it no longer goes through
+    RemoveRoute(bus_number);
+    std::sort(departures.begin(), departures.end());
+    all_buses_.push_back({ names_.Intern(bus_number), std::pmr::vector<const Stop*>(stops.begin(), stops.end(), &arena_),
+                           is_circle, std::pmr::vector<double>(departures.begin(), departures.end(), &arena_),
+                           BusStat{} });
+    Bus* bus = &all_buses_.back();
+    bus->stat = ComputeBusStat(*bus);
+    busname_to_bus_[bus->number] = bus;
+    InsertToIndex<const Bus*>(sorted_buses_, bus->number, bus);
+    IndexBusStops(bus);
+}
+
+void Catalogue::RemoveRoute(std::string_view bus_number) {
+    CheckNotFrozen();
+    const auto it = busname_to_bus_.find(bus_number);
+    if (it == busname_to_bus_.end()) return;
+    const Bus* bus = it->second;
+    for (const Stop* route_stop : bus->stops) {
+        auto& buses = stopname_to_stop_.at(route_stop->name)->buses_by_stop;
+        buses.erase(std::remove(buses.begin(), buses.end(), bus), buses.end());
+    }
+    EraseFromIndex(sorted_buses_, bus->number);
+    busname_to_bus_.erase(it);
+}
+
 const Bus* Catalogue::FindRoute(std::string_view bus_number) const {
     return busname_to_bus_.count(bus_number) ? busname_to_bus_.at(bus_number) : nullptr;
 }
@@ -26,37 +303,29 @@ const Stop* Catalogue::FindStop(std::string_view stop_name) const {
 }
 
 size_t Catalogue::UniqueStopsCount(std::string_view bus_number) const {
-    std::unordered_set<std::string_view> unique_stops;
-    for (const auto& stop : busname_to_bus_.at(bus_number)->stops) {
-        unique_stops.insert(stop->name);
-    }
-    return unique_stops.size();
+    return busname_to_bus_.at(bus_number)->stat.unique_stops_count;
 }
 
 void Catalogue::SetDistance(const Stop* from, const Stop* to, const int distance) {
-    stop_distances_[{from, to}] = distance;
+    CheckNotFrozen();
+    distances_.Set(from->id, to->id, distance);
+    // Every bus through both stops is among the buses of `from`
+    for (const Bus* bus : from->buses_by_stop) {
+        Bus* changed_bus = busname_to_bus_.at(bus->number);
+        changed_bus->stat = ComputeBusStat(*changed_bus);
+    }
 }
 
 int Catalogue::GetDistance(const Stop* from, const Stop* to) const {
-    if (stop_distances_.count({ from, to })) return stop_distances_.at({ from, to });
-    else if (stop_distances_.count({ to, from })) return stop_distances_.at({ to, from });
-    else return 0;
+    return distances_.Get(from->id, to->id);
 }
 
-const std::map<std::string_view, const Bus*> Catalogue::GetSortedAllBuses() const {
-    std::map<std::string_view, const Bus*> result;
-    for (const auto& bus : busname_to_bus_) {
-        result.emplace(bus);
-    }
-    return result;
+SortedBuses Catalogue::GetSortedAllBuses() const {
+    return {sorted_buses_.data(), sorted_buses_.data() + sorted_buses_.size()};
 }
 
-const std::map<std::string_view, const Stop*> Catalogue::GetSortedAllStops() const {
-    std::map<std::string_view, const Stop*> result;
-    for (const auto& stop : stopname_to_stop_) {
-        result.emplace(stop);
-    }
-    return result;
+SortedStops Catalogue::GetSortedAllStops() const {
+    return {sorted_stops_.data(), sorted_stops_.data() + sorted_stops_.size()};
 }
 
 }  // namespace transport
@@ -2,6 +2,8 @@
 
 #include "geo.h"
 #include "domain.h"
+#include "distance_table.h"
+#include "string_pool.h"
 
 #include <iostream>
 #include <deque>
@@ -12,36 +14,94 @@
 #include <optional>
 #include <unordered_set>
 #include <set>
-#include <map>
+#include <memory_resource>
 
 namespace transport {
 
+// Stops, buses, their names and their stop and bus lists are allocated from one
+// monotonic arena owned by the catalogue, and names are interned, so loading
+// makes few large allocations and destroying the catalogue releases them at once.
+// Memory of replaced and removed buses is only reclaimed then
 class Catalogue {
 public:
-    struct StopDistancesHasher {
-        size_t operator()(const std::pair<const Stop*, const Stop*>& points) const {
-            size_t hash_first = std::hash<const void*>{}(points.first);
-            size_t hash_second = std::hash<const void*>{}(points.second);
-            return hash_first + hash_second * 37;
-        }
-    };
+    Catalogue() = default;
+    Catalogue(const Catalogue&) = delete;
+    Catalogue& operator=(const Catalogue&) = delete;
+
+    // Bulk loading: Reserve() with the expected counts, then the Load* calls in any
+    // order, then Freeze(). The records refer to stops by name and are only
+    // resolved and indexed by Freeze(), in one pass, so the loaded elements are not
+    // found before it; the names passed to LoadDistance and LoadRoute must stay
+    // valid until then. A frozen catalogue is read-only: the modifying calls throw
+    // std::logic_error, and any number of threads may read it without locks.
+    // Thaw() allows the incremental changes and further loading again
+    void Reserve(size_t stop_count, size_t bus_count, size_t distance_count);
+    void LoadStop(std::string_view stop_name, geo::Coordinates coordinates);
+    void LoadDistance(std::string_view from_stop, std::string_view to_stop, int distance);
+    void LoadRoute(std::string_view bus_number, std::vector<std::string_view> stop_names, bool is_circle,
+                   std::vector<double> departures = {});
+    // A distance naming an unknown stop is skipped, as are the unknown stops of a
+    // route; a bus left without stops is not added. The stats of the buses are
+    // computed here, in parallel for a large catalogue
+    void Freeze();
+    // Must not run while other threads read the catalogue
+    void Thaw();
+    bool IsFrozen() const;
 
+    // Incremental changes, indexed right away
     void AddStop(std::string_view stop_name, const geo::Coordinates coordinates);
-    void AddRoute(std::string_view bus_number, const std::vector<const Stop*> stops, bool is_circle);
+    // departures are the timetable of the bus, see Bus::departures; any order
+    void AddRoute(std::string_view bus_number, const std::vector<const Stop*> stops, bool is_circle,
+                  std::vector<double> departures = {});
+    // The bus stays allocated, so pointers to it remain valid
+    void RemoveRoute(std::string_view bus_number);
+    // Also the distance from `to` to `from` unless that is set on its own
+    void SetDistance(const Stop* from, const Stop* to, const int distance);
+
     const Bus* FindRoute(std::string_view bus_number) const;
     const Stop* FindStop(std::string_view stop_name) const;
     size_t UniqueStopsCount(std::string_view bus_number) const;
-    void SetDistance(const Stop* from, const Stop* to, const int distance);
     int GetDistance(const Stop* from, const Stop* to) const;
-    const std::map<std::string_view, const Bus*> GetSortedAllBuses() const;
-    const std::map<std::string_view, const Stop*> GetSortedAllStops() const;
+    // Valid until the next change of the catalogue
+    SortedBuses GetSortedAllBuses() const;
+    SortedStops GetSortedAllStops() const;
 
 private:
-    std::deque<Bus> all_buses_;
-    std::deque<Stop> all_stops_;
-    std::unordered_map<std::string_view, const Bus*> busname_to_bus_;
-    std::unordered_map<std::string_view, const Stop*> stopname_to_stop_;
-    std::unordered_map<std::pair<const Stop*, const Stop*>, int, StopDistancesHasher> stop_distances_;
+    struct RouteRecord {
+        std::string_view number;
+        std::vector<std::string_view> stop_names;
+        bool is_circle;
+        std::vector<double> departures;
+    };
+
+    struct DistanceRecord {
+        std::string_view from;
+        std::string_view to;
+        int distance;
+    };
+
+    void CheckNotFrozen() const;
+    Stop& EmplaceStop(std::string_view stop_name, geo::Coordinates coordinates);
+    // Adds the bus to the sorted bus lists of its stops
+    void IndexBusStops(const Bus* bus);
+    BusStat ComputeBusStat(const Bus& bus) const;
+
+    // Declared first, so it outlives everything allocated from it
+    std::pmr::monotonic_buffer_resource arena_;
+    StringPool names_{&arena_};
+    std::pmr::deque<Bus> all_buses_{&arena_};
+    std::pmr::deque<Stop> all_stops_{&arena_};
+    std::unordered_map<std::string_view, Bus*> busname_to_bus_;
+    std::unordered_map<std::string_view, Stop*> stopname_to_stop_;
+    DistanceTable distances_;
+    std::vector<std::pair<std::string_view, const Bus*>> sorted_buses_;
+    std::vector<std::pair<std::string_view, const Stop*>> sorted_stops_;
+
+    // Loaded, not yet indexed
+    std::vector<Stop*> loaded_stops_;
+    std::vector<RouteRecord> loaded_routes_;
+    std::vector<DistanceRecord> loaded_distances_;
+    bool is_frozen_ = false;
 };
 
 }  // namespace transport
@@ -1,105 +1,953 @@
 #include "transport_router.h"
+#include "parallel.h"
+#include "route_units.h"
+
+#include <algorithm>
+#include <tuple>
+#include <type_traits>
 
 namespace transport {
 
 namespace {
-constexpr double KM_TO_M = 1000.0;
-constexpr double HOUR_TO_MIN = 60.0;
+// Below this many edges the graph is built on the calling thread
+constexpr size_t PARALLEL_BUILD_MIN_EDGES = 1 << 16;
+// Edges added by updates stay in the overflow lists of the graph until they make
+// up this share of all edges, then the graph is frozen again
+constexpr size_t OVERFLOW_REFREEZE_DIVISOR = 8;
+// Above this many targets of one source the goal-directed engines (contraction
+// hierarchies, ALT) give way to a single Dijkstra over the graph
+constexpr size_t GOAL_DIRECTED_MAX_TARGETS = 4;
+
+// Per-thread buffers of the route queries
+struct RouteBuffers {
+    std::vector<graph::EdgeId> edges;
+    std::vector<RaptorRouter::Leg> legs;
+    std::vector<RouteEdgeInfo> items;
+};
+
+RouteBuffers& GetRouteBuffers() {
+    thread_local RouteBuffers buffers;
+    return buffers;
+}
+
+// Default settings apart from the bus parameters
+RoutingSettings MakeBusSettings(int bus_wait_time, double bus_velocity) {
+    RoutingSettings settings;
+    settings.bus_wait_time = bus_wait_time;
+    settings.bus_velocity = bus_velocity;
+    return settings;
+}
+
+bool HasDepartures(const Catalogue& catalogue) {
+    const SortedBuses buses = catalogue.GetSortedAllBuses();
+    return std::any_of(buses.begin(), buses.end(), [](const auto& entry) {
+        return !entry.second->departures.empty();
+    });
+}
 } // namespace
 
 Router::Router(const Catalogue& catalogue, int bus_wait_time, double bus_velocity) 
-    : bus_wait_time_(bus_wait_time), bus_velocity_(bus_velocity) {
-    BuildGraph(catalogue);
+    : Router(catalogue, MakeBusSettings(bus_wait_time, bus_velocity)) {
+}
+
+Router::Router(const Catalogue& catalogue, const RoutingSettings& settings)
+    : settings_(settings)
+    , route_cache_(std::make_unique<RouteCache<std::optional<RouteInfo>>>(settings.route_cache_size)) {
+    // Without departures no timetable query can find a trip, so the timetable is
+    // only built once a bus has some
+    if (settings_.engine == RouterEngine::CONNECTION_SCAN || HasDepartures(catalogue)) {
+        timetable_ = std::make_unique<ConnectionScanRouter>(catalogue, settings_.bus_velocity);
+    }
+    if (settings_.engine == RouterEngine::RAPTOR || settings_.engine == RouterEngine::CONNECTION_SCAN) {
+        if (settings_.engine == RouterEngine::RAPTOR) {
+            raptor_ = std::make_unique<RaptorRouter>(catalogue, settings_.bus_wait_time,
+                                                     settings_.bus_velocity);
+        }
+        // No graph, but the route cache is still keyed by the stops' vertex ids
+        graph::VertexId vertex_id = 0;
+        for (const auto& [stop_name, stop_info] : catalogue.GetSortedAllStops()) {
+            stop_ids_[stop_info->name] = vertex_id;
+            vertex_id += 2;
+        }
+        return;
+    }
+    if (settings_.index_file.empty()) {
+        BuildGraph(catalogue);
+        BuildRouter();
+        return;
+    }
+
+    const uint64_t key = ComputeIndexKey(catalogue);
+    if (!LoadIndex(catalogue, key)) {
+        BuildGraph(catalogue);
+        BuildRouter();
+        SaveIndex(key);
+    }
 }
 
 void Router::BuildGraph(const Catalogue& catalogue) {
-    const auto& all_stops = catalogue.GetSortedAllStops();
-    graph_ = graph::DirectedWeightedGraph<double>(all_stops.size() * 2);
+    const std::vector<const Stop*> all_stops = OrderStops(catalogue, settings_.vertex_order);
+    const SortedBuses all_buses = catalogue.GetSortedAllBuses();
     stop_ids_.clear();
-    edge_info_.clear();
+    stop_names_.clear();
+    bus_ids_.clear();
+    bus_names_.clear();
+    edge_info_.Clear();
+    bus_edges_.clear();
+    free_edges_.clear();
+    route_cache_->Clear();
+
+    const size_t stop_count = all_stops.size();
+    stop_names_.reserve(stop_count);
+    for (const Stop* stop : all_stops) {
+        stop_ids_[stop->name] = stop_names_.size() * 2;
+        stop_names_.push_back(stop->name);
+    }
+
+    // Wait edges come first, then the edges of each bus in name order; their
+    // ids are fixed up front, so the buses can be filled in any order
+    std::vector<const Bus*> buses;
+    std::vector<uint32_t> bus_indices;
+    std::vector<graph::EdgeId> first_edges;
+    buses.reserve(all_buses.size());
+    bus_indices.reserve(all_buses.size());
+    first_edges.reserve(all_buses.size() + 1);
+    // The wait edges come first, one per stop
+    first_edges.push_back(stop_count);
+    bus_names_.reserve(all_buses.size());
+    for (const auto& [bus_name, bus_info] : all_buses) {
+        buses.push_back(bus_info);
+        bus_indices.push_back(GetBusIndex(*bus_info));
+        first_edges.push_back(first_edges.back() + CountRides(*bus_info));
+    }
+    const size_t edge_count = first_edges.back();
+
+    std::vector<graph::Edge<RouteWeight>> edges(edge_count);
+    edge_info_.Resize(edge_count);
+    // Reported times are those of the weights, so they add up to the route time
+    const RouteWeight wait_weight = MinutesToWeight(settings_.bus_wait_time);
+    for (graph::EdgeId edge_id = 0; edge_id < stop_count; ++edge_id) {
+        edges[edge_id] = {edge_id * 2, edge_id * 2 + 1, wait_weight};
+        edge_info_.Set(edge_id, RoutingIndex::NO_INDEX, static_cast<uint32_t>(edge_id), 0,
+                       WeightToMinutes(wait_weight));
+    }
+
+    // Each task writes only the edge slots of its bus and reads the catalogue
+    // and stop_ids_, which do not change meanwhile
+    const size_t thread_count = edge_count < PARALLEL_BUILD_MIN_EDGES ? 1 : settings_.thread_count;
+    parallel::Run(thread_count, buses.size(), [&](size_t bus) {
+        const std::vector<graph::VertexId> vertices = GetStopVertices(*buses[bus]);
+        graph::EdgeId edge_id = first_edges[bus];
+        ForEachRide(catalogue, *buses[bus], [&](size_t from, size_t to, int span_count, double travel_time) {
+            const RouteWeight weight = MinutesToWeight(travel_time);
+            edges[edge_id] = {vertices[from] + 1, vertices[to], weight};
+            edge_info_.Set(edge_id, bus_indices[bus], RoutingIndex::NO_INDEX, span_count, WeightToMinutes(weight));
+            ++edge_id;
+        });
+    });
+
+    for (size_t bus = 0; bus < buses.size(); ++bus) {
+        bus_edges_[buses[bus]->number] = {first_edges[bus], first_edges[bus + 1] - first_edges[bus]};
+    }
+    graph_ = graph::DirectedWeightedGraph<RouteWeight>(stop_count * 2, std::move(edges));
+}
+
+size_t Router::CountRides(const Bus& bus) {
+    // A bus rides between every ordered pair of its stops, in one or both directions
+    const size_t stop_count = bus.stops.size();
+    const size_t ride_count = stop_count > 1 ? stop_count * (stop_count - 1) / 2 : 0;
+    return bus.is_circle ? ride_count : ride_count * 2;
+}
+
+std::vector<graph::VertexId> Router::GetStopVertices(const Bus& bus) const {
+    std::vector<graph::VertexId> vertices;
+    vertices.reserve(bus.stops.size());
+    for (const Stop* stop : bus.stops) {
+        vertices.push_back(stop_ids_.at(stop->name));
+    }
+    return vertices;
+}
+
+template <typename RideHandler>
+void Router::ForEachRide(const Catalogue& catalogue, const Bus& bus, RideHandler handle_ride) const {
+    const auto& stops = bus.stops;
+    const size_t stop_count = stops.size();
+    if (stop_count < 2) return;
+
+    // Road distances from the first stop, one lookup per segment: a ride is then
+    // the difference of two prefix sums
+    std::vector<int64_t> forward_distances(stop_count, 0);
+    std::vector<int64_t> backward_distances(bus.is_circle ? 0 : stop_count, 0);
+    for (size_t i = 1; i < stop_count; ++i) {
+        forward_distances[i] = forward_distances[i - 1] + catalogue.GetDistance(stops[i - 1], stops[i]);
+        if (!bus.is_circle) {
+            backward_distances[i] = backward_distances[i - 1] + catalogue.GetDistance(stops[i], stops[i - 1]);
+        }
+    }
+
+    const double velocity_m_per_min = ToMetersPerMinute(settings_.bus_velocity);
+    for (size_t i = 0; i < stop_count - 1; ++i) {
+        for (size_t j = i + 1; j < stop_count; ++j) {
+            const double distance = static_cast<double>(forward_distances[j] - forward_distances[i]);
+            handle_ride(i, j, static_cast<int>(j - i), distance / velocity_m_per_min);
+        }
+    }
+
+    if (!bus.is_circle) {
+        for (size_t i = stop_count - 1; i > 0; --i) {
+            for (size_t j = i - 1; j != static_cast<size_t>(-1); --j) {
+                const double distance = static_cast<double>(backward_distances[i] - backward_distances[j]);
+                handle_ride(i, j, static_cast<int>(i - j), distance / velocity_m_per_min);
+            }
+        }
+    }
+}
 
-    const double velocity_m_per_min = bus_velocity_ * KM_TO_M / HOUR_TO_MIN;
+void Router::AddBusEdges(const Catalogue& catalogue, const Bus& bus, graph::EdgeId first_edge,
+                         std::vector<graph::EdgeUpdate<RouteWeight>>& updates) {
+    const uint32_t bus_index = GetBusIndex(bus);
+    const std::vector<graph::VertexId> vertices = GetStopVertices(bus);
+    graph::EdgeId edge_id = first_edge;
+    ForEachRide(catalogue, bus, [&](size_t from, size_t to, int span_count, double travel_time) {
+        const graph::Edge<RouteWeight> edge{vertices[from] + 1, vertices[to], MinutesToWeight(travel_time)};
+        const double time = WeightToMinutes(edge.weight);
+        if (edge_id == graph_.GetEdgeCount()) {
+            graph_.AddEdge(edge);
+            edge_info_.Add(bus_index, RoutingIndex::NO_INDEX, span_count, time);
+            updates.push_back({edge_id, {edge.from, edge.to, graph::WeightTraits<RouteWeight>::INFINITE_WEIGHT}});
+        } else {
+            const graph::Edge<RouteWeight> old_edge = graph_.GetEdge(edge_id);
+            if (old_edge.from != edge.from || old_edge.to != edge.to || old_edge.weight != edge.weight) {
+                graph_.SetEdge(edge_id, edge);
+                updates.push_back({edge_id, old_edge});
+            }
+            edge_info_.Set(edge_id, bus_index, RoutingIndex::NO_INDEX, span_count, time);
+        }
+        ++edge_id;
+    });
+}
+
+graph::EdgeId Router::AllocateEdges(size_t count) {
+    for (auto it = free_edges_.begin(); it != free_edges_.end(); ++it) {
+        if (it->count >= count) {
+            const graph::EdgeId first = it->first;
+            it->first += count;
+            it->count -= count;
+            if (it->count == 0) {
+                free_edges_.erase(it);
+            }
+            return first;
+        }
+    }
+    return graph_.GetEdgeCount();
+}
 
-    graph::VertexId vertex_id = 0;
-    for (const auto& [stop_name, stop_info] : all_stops) {
-        stop_ids_[stop_info->name] = vertex_id;
-        
-        graph::Edge<double> wait_edge{vertex_id, vertex_id + 1, 
-                                    static_cast<double>(bus_wait_time_)};
-        auto edge_id = graph_.AddEdge(wait_edge);
-        edge_info_[edge_id] = {"", 0, static_cast<double>(bus_wait_time_), stop_info->name};
-        
-        vertex_id += 2;
+void Router::FreeEdges(EdgeRange edges) {
+    if (edges.count == 0) {
+        return;
+    }
+    // Sorted by first id, with adjacent ranges merged
+    auto next = std::lower_bound(free_edges_.begin(), free_edges_.end(), edges.first,
+                                 [](const EdgeRange& range, graph::EdgeId first) {
+                                     return range.first < first;
+                                 });
+    if (next != free_edges_.end() && edges.first + edges.count == next->first) {
+        edges.count += next->count;
+        next = free_edges_.erase(next);
     }
+    if (next != free_edges_.begin()) {
+        EdgeRange& previous = *(next - 1);
+        if (previous.first + previous.count == edges.first) {
+            previous.count += edges.count;
+            return;
+        }
+    }
+    free_edges_.insert(next, edges);
+}
 
+uint32_t Router::GetBusIndex(const Bus& bus) {
+    const auto [it, is_new] = bus_ids_.emplace(bus.number, static_cast<uint32_t>(bus_names_.size()));
+    if (is_new) {
+        bus_names_.push_back(bus.number);
+    }
+    return it->second;
+}
+
+Router::EdgeInfoTable::View Router::EdgeInfoTable::GetView() const {
+    if (is_borrowed_) {
+        return borrowed_;
+    }
+    return {bus_indices_.data(), stop_indices_.data(), span_counts_.data(), times_.data()};
+}
+
+void Router::EdgeInfoTable::Borrow(View view, size_t edge_count) {
+    Clear();
+    is_borrowed_ = true;
+    borrowed_ = view;
+    borrowed_size_ = edge_count;
+}
+
+void Router::EdgeInfoTable::Own() {
+    if (!is_borrowed_) {
+        return;
+    }
+    bus_indices_.assign(borrowed_.bus_indices, borrowed_.bus_indices + borrowed_size_);
+    stop_indices_.assign(borrowed_.stop_indices, borrowed_.stop_indices + borrowed_size_);
+    span_counts_.assign(borrowed_.span_counts, borrowed_.span_counts + borrowed_size_);
+    times_.assign(borrowed_.times, borrowed_.times + borrowed_size_);
+    is_borrowed_ = false;
+}
+
+void Router::EdgeInfoTable::Clear() {
+    is_borrowed_ = false;
+    bus_indices_.clear();
+    stop_indices_.clear();
+    span_counts_.clear();
+    times_.clear();
+}
+
+void Router::EdgeInfoTable::Resize(size_t edge_count) {
+    Own();
+    bus_indices_.resize(edge_count);
+    stop_indices_.resize(edge_count);
+    span_counts_.resize(edge_count);
+    times_.resize(edge_count);
+}
+
+void Router::EdgeInfoTable::Set(graph::EdgeId edge_id, uint32_t bus_index, uint32_t stop_index, int span_count,
+                                double time) {
+    Own();
+    bus_indices_[edge_id] = bus_index;
+    stop_indices_[edge_id] = stop_index;
+    span_counts_[edge_id] = span_count;
+    times_[edge_id] = time;
+}
+
+void Router::EdgeInfoTable::SetTime(graph::EdgeId edge_id, double time) {
+    Own();
+    times_[edge_id] = time;
+}
+
+void Router::EdgeInfoTable::Add(uint32_t bus_index, uint32_t stop_index, int span_count, double time) {
+    Own();
+    bus_indices_.push_back(bus_index);
+    stop_indices_.push_back(stop_index);
+    span_counts_.push_back(span_count);
+    times_.push_back(time);
+}
+
+void Router::BuildRouter() {
+    switch (settings_.engine) {
+    case RouterEngine::ALL_PAIRS:
+        router_ = std::make_unique<graph::Router<RouteWeight>>(graph_);
+        break;
+    case RouterEngine::DIJKSTRA:
+        router_ = std::make_unique<graph::DijkstraRouter<RouteWeight>>(graph_, settings_.tree_cache_size);
+        break;
+    case RouterEngine::CONTRACTION_HIERARCHIES:
+        router_ = std::make_unique<graph::ContractionHierarchy<RouteWeight>>(graph_);
+        break;
+    case RouterEngine::BLOCKED_ALL_PAIRS:
+        router_ = std::make_unique<graph::BlockedRouter<RouteWeight>>(graph_, settings_.thread_count);
+        break;
+    case RouterEngine::COMPACT_ALL_PAIRS:
+        router_ = std::make_unique<graph::CompactRouter<RouteWeight>>(graph_, settings_.thread_count);
+        break;
+    case RouterEngine::ALT:
+        router_ = std::make_unique<graph::AltRouter<RouteWeight>>(graph_, settings_.landmark_count);
+        break;
+    case RouterEngine::RAPTOR:
+    case RouterEngine::CONNECTION_SCAN:
+        break;
+    }
+}
+
+void Router::AddBus(const Catalogue& catalogue, std::string_view bus_name) {
+    const Bus* bus = catalogue.FindRoute(bus_name);
+    if (!bus) {
+        throw std::invalid_argument("Unknown bus");
+    }
+    for (const Stop* stop : bus->stops) {
+        if (stop_ids_.count(stop->name) == 0) {
+            throw std::invalid_argument("Bus goes through a stop the router was not built with");
+        }
+    }
+    if (timetable_) {
+        timetable_->AddBus(catalogue, bus);
+    } else if (!bus->departures.empty()) {
+        timetable_ = std::make_unique<ConnectionScanRouter>(catalogue, settings_.bus_velocity);
+    }
+    if (raptor_) {
+        raptor_->AddBus(catalogue, bus);
+        route_cache_->Clear();
+        return;
+    }
+    if (settings_.engine == RouterEngine::CONNECTION_SCAN) {
+        return;
+    }
+
+    // A changed bus with as many rides keeps its edge ids. Otherwise its old edges
+    // are freed, and the new ones take the first free range that fits or are
+    // appended, so the edges of removed buses are reused
+    std::vector<graph::EdgeUpdate<RouteWeight>> updates;
+    const size_t ride_count = CountRides(*bus);
+    const auto edges_it = bus_edges_.find(bus->number);
+    graph::EdgeId first_edge = 0;
+    if (edges_it != bus_edges_.end() && edges_it->second.count == ride_count) {
+        first_edge = edges_it->second.first;
+    } else {
+        updates = RemoveBusEdges(bus->number);
+        first_edge = AllocateEdges(ride_count);
+        bus_edges_[bus->number] = {first_edge, ride_count};
+    }
+    AddBusEdges(catalogue, *bus, first_edge, updates);
+    // Folds the overflow edges into the CSR arrays and drops the dead slots
+    if ((graph_.GetOverflowEdgeCount() + graph_.GetDeadSlotCount()) * OVERFLOW_REFREEZE_DIVISOR
+        > graph_.GetEdgeCount()) {
+        graph_.Freeze();
+    }
+    RepairRouter(updates);
+}
+
+void Router::RemoveBus(std::string_view bus_name) {
+    if (timetable_) {
+        timetable_->RemoveBus(bus_name);
+    }
+    if (raptor_) {
+        raptor_->RemoveBus(bus_name);
+        route_cache_->Clear();
+        return;
+    }
+    if (settings_.engine == RouterEngine::CONNECTION_SCAN) {
+        return;
+    }
+    RepairRouter(RemoveBusEdges(bus_name));
+}
+
+void Router::UpdateDistance(const Catalogue& catalogue, std::string_view from_stop, std::string_view to_stop) {
+    const Stop* from = catalogue.FindStop(from_stop);
+    const Stop* to = catalogue.FindStop(to_stop);
+    if (!from || !to) {
+        throw std::invalid_argument("Unknown stop");
+    }
+
+    // GetDistance falls back to the opposite direction, so a bus is affected if it
+    // has the two stops next to each other in either order
+    std::vector<const Bus*> buses;
+    for (const Bus* bus : from->buses_by_stop) {
+        for (size_t i = 1; i < bus->stops.size(); ++i) {
+            if ((bus->stops[i - 1] == from && bus->stops[i] == to) || (bus->stops[i - 1] == to && bus->stops[i] == from)) {
+                buses.push_back(bus);
+                break;
+            }
+        }
+    }
+
+    if (timetable_) {
+        // Neither buses removed from the router nor changed ones not added again
+        for (const Bus* bus : buses) {
+            if (timetable_->HasBus(bus)) {
+                timetable_->AddBus(catalogue, bus);
+            }
+        }
+    }
+    if (raptor_) {
+        for (const Bus* bus : buses) {
+            raptor_->UpdateBusDistances(catalogue, bus->number);
+        }
+        route_cache_->Clear();
+        return;
+    }
+    if (settings_.engine == RouterEngine::CONNECTION_SCAN) {
+        return;
+    }
+
+    std::vector<graph::EdgeUpdate<RouteWeight>> updates;
+    for (const Bus* bus : buses) {
+        const auto edges_it = bus_edges_.find(bus->number);
+        if (edges_it == bus_edges_.end()) continue;  // removed from the router only
+        // Changed in the catalogue but not added to the router again: its edges are
+        // not the rides of the catalogue's bus, and AddBus will rewrite them anyway
+        if (CountRides(*bus) != edges_it->second.count) continue;
+        const std::vector<graph::VertexId> vertices = GetStopVertices(*bus);
+        graph::EdgeId edge_id = edges_it->second.first;
+        ForEachRide(catalogue, *bus, [&](size_t from, size_t to, int, double travel_time) {
+            const graph::Edge<RouteWeight> old_edge = graph_.GetEdge(edge_id);
+            const RouteWeight weight = MinutesToWeight(travel_time);
+            if (old_edge.from == vertices[from] + 1 && old_edge.to == vertices[to] && old_edge.weight != weight) {
+                graph_.SetEdgeWeight(edge_id, weight);
+                edge_info_.SetTime(edge_id, WeightToMinutes(weight));
+                updates.push_back({edge_id, old_edge});
+            }
+            ++edge_id;
+        });
+    }
+    RepairRouter(updates);
+}
+
+std::vector<graph::EdgeUpdate<RouteWeight>> Router::RemoveBusEdges(std::string_view bus_name) {
+    std::vector<graph::EdgeUpdate<RouteWeight>> updates;
+    const auto it = bus_edges_.find(bus_name);
+    if (it == bus_edges_.end()) {
+        return updates;
+    }
+    // The edges stay in the graph with +inf weight, so edge ids do not change, and
+    // their range is reused by the next buses that fit in it
+    for (graph::EdgeId edge_id = it->second.first; edge_id < it->second.first + it->second.count; ++edge_id) {
+        updates.push_back({edge_id, graph_.GetEdge(edge_id)});
+        graph_.RemoveEdge(edge_id);
+    }
+    FreeEdges(it->second);
+    bus_edges_.erase(it);
+    return updates;
+}
+
+void Router::RepairRouter(const std::vector<graph::EdgeUpdate<RouteWeight>>& updates) {
+    route_cache_->Clear();
+    if (updates.empty()) {
+        return;
+    }
+    std::visit([this, &updates](auto& engine) {
+        using Engine = typename std::decay_t<decltype(engine)>::element_type;
+        if (!engine) {
+            return;
+        }
+        if constexpr (std::is_same_v<Engine, graph::ContractionHierarchy<RouteWeight>>) {
+            // The contraction order and shortcuts depend on all weights, so the
+            // hierarchy has to be rebuilt; that waits for the next query
+            stale_router_->is_stale.store(true, std::memory_order_release);
+        } else {
+            engine->Repair(updates);
+        }
+    }, router_);
+}
+
+void Router::RebuildStaleRouter() const {
+    if (!stale_router_->is_stale.load(std::memory_order_acquire)) {
+        return;
+    }
+    // Queries never run together with updates, so no query reads router_ here:
+    // the others wait for the lock
+    std::lock_guard lock(stale_router_->mutex);
+    if (stale_router_->is_stale.load(std::memory_order_relaxed)) {
+        router_ = std::make_unique<graph::ContractionHierarchy<RouteWeight>>(graph_);
+        stale_router_->is_stale.store(false, std::memory_order_release);
+    }
+}
+
+uint64_t Router::ComputeIndexKey(const Catalogue& catalogue) const {
+    RoutingKeyBuilder key;
+    key.Add(RoutingIndex::FORMAT_VERSION)
+       .Add(settings_.bus_wait_time)
+       .Add(settings_.bus_velocity)
+       .Add(settings_.engine)
+       .Add(settings_.vertex_order)
+       .Add(sizeof(RouteWeight))
+       .Add(std::is_floating_point_v<RouteWeight>);
+    for (const auto& [stop_name, stop_info] : catalogue.GetSortedAllStops()) {
+        key.Add(stop_info->name);
+        if (settings_.vertex_order == VertexOrder::HILBERT) {
+            key.Add(stop_info->coordinates.lat).Add(stop_info->coordinates.lng);
+        }
+    }
     for (const auto& [bus_name, bus_info] : catalogue.GetSortedAllBuses()) {
-        const auto& stops = bus_info->stops;
-        const size_t stop_count = stops.size();
-        
-        if (stop_count < 2) continue;
-
-        for (size_t i = 0; i < stop_count - 1; ++i) {
-            int distance_sum = 0;
-            for (size_t j = i + 1; j < stop_count; ++j) {
-                distance_sum += catalogue.GetDistance(stops[j-1], stops[j]);
-                double travel_time = distance_sum / velocity_m_per_min;
-                
-                graph::Edge<double> bus_edge{
-                    stop_ids_.at(stops[i]->name) + 1,
-                    stop_ids_.at(stops[j]->name),
-                    travel_time
-                };
-                auto edge_id = graph_.AddEdge(bus_edge);
-                edge_info_[edge_id] = {bus_info->number, static_cast<int>(j - i), 
-                                      travel_time, ""};
-            }
-        }
-
-        if (!bus_info->is_circle) {
-            for (size_t i = stop_count - 1; i > 0; --i) {
-                int distance_sum = 0;
-                for (size_t j = i - 1; j != static_cast<size_t>(-1); --j) {
-                    distance_sum += catalogue.GetDistance(stops[j+1], stops[j]);
-                    double travel_time = distance_sum / velocity_m_per_min;
-                    
-                    graph::Edge<double> reverse_edge{
-                        stop_ids_.at(stops[i]->name) + 1,
-                        stop_ids_.at(stops[j]->name),
-                        travel_time
-                    };
-                    auto edge_id = graph_.AddEdge(reverse_edge);
-                    edge_info_[edge_id] = {bus_info->number, static_cast<int>(i - j), 
-                                          travel_time, ""};
-                }
+        key.Add(bus_info->number).Add(bus_info->is_circle).Add(bus_info->stops.size());
+        for (size_t i = 0; i < bus_info->stops.size(); ++i) {
+            key.Add(bus_info->stops[i]->name);
+            if (i > 0) {
+                key.Add(catalogue.GetDistance(bus_info->stops[i - 1], bus_info->stops[i]))
+                   .Add(catalogue.GetDistance(bus_info->stops[i], bus_info->stops[i - 1]));
             }
         }
     }
+    return key.Get();
+}
+
+bool Router::LoadIndex(const Catalogue& catalogue, uint64_t key) {
+    auto index = RoutingIndex::Open(settings_.index_file, key, static_cast<uint32_t>(settings_.engine));
+    if (!index) {
+        return false;
+    }
+    const auto& contents = index->GetContents();
+
+    // The same orders as SaveIndex: the key covers everything they depend on
+    const std::vector<const Stop*> stops = OrderStops(catalogue, settings_.vertex_order);
+    const SortedBuses buses = catalogue.GetSortedAllBuses();
+    if (contents.vertex_count != stops.size() * 2 || contents.bus_count != buses.size()) {
+        return false;
+    }
+    for (size_t bus = 0; bus < contents.bus_count; ++bus) {
+        const RoutingIndex::BusEdges& edges = contents.bus_edges[bus];
+        if (edges.first > contents.edge_count || edges.count > contents.edge_count - edges.first) {
+            return false;
+        }
+    }
 
-    router_ = std::make_unique<graph::Router<double>>(graph_);
+    stop_ids_.clear();
+    stop_names_.clear();
+    bus_ids_.clear();
+    bus_names_.clear();
+    bus_edges_.clear();
+    free_edges_.clear();
+    route_cache_->Clear();
+    for (size_t i = 0; i < stops.size(); ++i) {
+        stop_ids_[stops[i]->name] = i * 2;
+        stop_names_.push_back(stops[i]->name);
+    }
+    for (const auto& [bus_name, bus_info] : buses) {
+        const RoutingIndex::BusEdges& edges = contents.bus_edges[GetBusIndex(*bus_info)];
+        bus_edges_[bus_info->number] = {edges.first, edges.count};
+    }
+
+    // The graph, the edge metadata and the all-pairs tables are used straight from
+    // the mapped file; the other engines build their state from the graph
+    graph_ = graph::DirectedWeightedGraph<RouteWeight>(
+        contents.vertex_count,
+        {contents.edges, contents.edge_count, contents.vertex_offsets, contents.incident_edges});
+    edge_info_.Borrow({contents.bus_indices, contents.stop_indices, contents.span_counts, contents.times},
+                      contents.edge_count);
+    const bool has_table = contents.table != nullptr;
+    if (settings_.engine == RouterEngine::ALL_PAIRS && has_table) {
+        router_ = std::make_unique<graph::Router<RouteWeight>>(
+            graph_, graph::Router<RouteWeight>::TableView{contents.table, contents.table_size});
+    } else if (settings_.engine == RouterEngine::BLOCKED_ALL_PAIRS && has_table) {
+        router_ = std::make_unique<graph::BlockedRouter<RouteWeight>>(
+            graph_, graph::BlockedRouter<RouteWeight>::TableView{contents.table, contents.table_size, contents.table_stride});
+    } else if (settings_.engine == RouterEngine::COMPACT_ALL_PAIRS && has_table) {
+        router_ = std::make_unique<graph::CompactRouter<RouteWeight>>(
+            graph_, graph::CompactRouter<RouteWeight>::TableView{contents.table, contents.table_size, contents.table_stride});
+    } else {
+        BuildRouter();
+    }
+    index_ = std::move(index);
+    return true;
+}
+
+void Router::SaveIndex(uint64_t key) const {
+    // Only called right after BuildGraph, so the graph is frozen without overflow
+    // edges, bus indices follow the name order of the buses and stop indices follow
+    // OrderStops(catalogue, settings_.vertex_order). LoadIndex rebuilds the names
+    // in these same orders; the key covers the vertex order and all it depends on
+    const auto csr = graph_.GetCsrView();
+    const auto edge_info = edge_info_.GetView();
+    std::vector<RoutingIndex::BusEdges> bus_edges(bus_names_.size());
+    for (size_t bus = 0; bus < bus_names_.size(); ++bus) {
+        const EdgeRange& edges = bus_edges_.at(bus_names_[bus]);
+        bus_edges[bus] = {edges.first, edges.count};
+    }
+
+    RoutingIndex::Contents contents;
+    contents.key = key;
+    contents.engine = static_cast<uint32_t>(settings_.engine);
+    contents.vertex_count = graph_.GetVertexCount();
+    contents.edge_count = csr.edge_count;
+    contents.bus_count = bus_edges.size();
+    contents.edges = csr.edges;
+    contents.vertex_offsets = csr.offsets;
+    contents.incident_edges = csr.incident_edges;
+    contents.bus_indices = edge_info.bus_indices;
+    contents.stop_indices = edge_info.stop_indices;
+    contents.span_counts = edge_info.span_counts;
+    contents.times = edge_info.times;
+    contents.bus_edges = bus_edges.data();
+    std::visit([this, &contents](const auto& engine) {
+        using Engine = typename std::decay_t<decltype(engine)>::element_type;
+        if constexpr (std::is_same_v<Engine, graph::Router<RouteWeight>>) {
+            if (engine) {
+                const auto table = engine->GetTable();
+                contents.table = table.data;
+                contents.table_size = table.size;
+                contents.table_stride = graph_.GetVertexCount();
+            }
+        } else if constexpr (std::is_same_v<Engine, graph::BlockedRouter<RouteWeight>>
+                      || std::is_same_v<Engine, graph::CompactRouter<RouteWeight>>) {
+            if (engine) {
+                const auto table = engine->GetTable();
+                contents.table = table.data;
+                contents.table_size = table.size;
+                contents.table_stride = table.stride;
+            }
+        }
+    }, router_);
+
+    RoutingIndex::Save(settings_.index_file, contents);
+}
+
+void Router::CheckHasGraph() const {
+    if (settings_.engine == RouterEngine::CONNECTION_SCAN) {
+        throw std::logic_error("The connection_scan engine only finds routes with a departure time");
+    }
 }
 
 std::optional<RouteInfo> Router::FindRoute(std::string_view from, std::string_view to) const {
+    CheckHasGraph();
     try {
-        if (stop_ids_.count(std::string(from)) == 0 || stop_ids_.count(std::string(to)) == 0) {
+        const auto from_it = stop_ids_.find(from);
+        const auto to_it = stop_ids_.find(to);
+        if (from_it == stop_ids_.end() || to_it == stop_ids_.end()) {
             return std::nullopt;
         }
-        
-        auto route = router_->BuildRoute(stop_ids_.at(std::string(from)), stop_ids_.at(std::string(to)));
-        if (!route) {
+        std::optional<RouteInfo> route;
+        if (route_cache_->Find(from_it->second, to_it->second, route)) {
+            return route;
+        }
+
+        RebuildStaleRouter();
+        if (raptor_) {
+            if (auto journey = raptor_->FindJourney(from, to)) {
+                route = MakeRouteInfo(*journey);
+            }
+        } else {
+            std::vector<graph::EdgeId>& edges = GetRouteBuffers().edges;
+            route = std::visit([&](const auto& engine) -> std::optional<RouteInfo> {
+                if (!engine) {
+                    return std::nullopt;
+                }
+                const auto weight = engine->BuildRoute(from_it->second, to_it->second, edges);
+                if (!weight) {
+                    return std::nullopt;
+                }
+                return MakeRouteInfo(WeightToMinutes(*weight), edges);
+            }, router_);
+        }
+        route_cache_->Insert(from_it->second, to_it->second, route);
+        return route;
+    } catch (...) {
+        return std::nullopt;
+    }
+}
+
+std::optional<RouteInfo> Router::FindRoute(std::string_view from, std::string_view to,
+                                           double departure_time) const {
+    if (!timetable_) {
+        return std::nullopt;
+    }
+    if (const auto journey = timetable_->FindJourney(from, to, departure_time)) {
+        return MakeRouteInfo(*journey);
+    }
+    return std::nullopt;
+}
+
+std::optional<RouteView> Router::FindRouteView(std::string_view from, std::string_view to) const {
+    CheckHasGraph();
+    try {
+        const auto from_it = stop_ids_.find(from);
+        const auto to_it = stop_ids_.find(to);
+        if (from_it == stop_ids_.end() || to_it == stop_ids_.end()) {
             return std::nullopt;
         }
-        
-        RouteInfo result;
-        result.total_time = route->weight;
-        
-        for (const auto& edge_id : route->edges) {
-            result.edges.push_back(edge_info_.at(edge_id));
+
+        RouteBuffers& buffers = GetRouteBuffers();
+        buffers.items.clear();
+        double total_time = 0.0;
+        RebuildStaleRouter();
+        if (raptor_) {
+            const auto journey_time = raptor_->FindJourney(from, to, buffers.legs);
+            if (!journey_time) {
+                return std::nullopt;
+            }
+            for (const auto& leg : buffers.legs) {
+                buffers.items.push_back({{}, 0, leg.wait_time, leg.board_stop->name});
+                buffers.items.push_back({leg.bus->number, leg.span_count, leg.ride_time, {}});
+            }
+            total_time = *journey_time;
+        } else {
+            const bool is_found = std::visit([&](const auto& engine) {
+                using Engine = typename std::decay_t<decltype(engine)>::element_type;
+                if (!engine) {
+                    return false;
+                }
+                std::optional<RouteWeight> weight;
+                if constexpr (std::is_same_v<Engine, graph::DijkstraRouter<RouteWeight>>) {
+                    // A tree cached for the view would be allocated
+                    weight = engine->BuildRouteUncached(from_it->second, to_it->second, buffers.edges);
+                } else {
+                    weight = engine->BuildRoute(from_it->second, to_it->second, buffers.edges);
+                }
+                if (!weight) {
+                    return false;
+                }
+                total_time = WeightToMinutes(*weight);
+                return true;
+            }, router_);
+            if (!is_found) {
+                return std::nullopt;
+            }
+            for (const graph::EdgeId edge_id : buffers.edges) {
+                buffers.items.push_back(GetEdgeInfo(edge_id));
+            }
         }
-        
-        return result;
+        return RouteView{total_time, {buffers.items.data(), buffers.items.data() + buffers.items.size()}};
     } catch (...) {
         return std::nullopt;
     }
 }
 
+std::optional<std::vector<ReachableStop>> Router::FindReachableStops(std::string_view from,
+                                                                    double max_time) const {
+    CheckHasGraph();
+    std::vector<ReachableStop> reachable;
+    if (raptor_) {
+        auto stops = raptor_->FindReachableStops(from, max_time);
+        if (!stops) {
+            return std::nullopt;
+        }
+        for (const auto& [stop, time] : *stops) {
+            reachable.push_back({stop->name, time});
+        }
+    } else {
+        const auto from_it = stop_ids_.find(from);
+        if (from_it == stop_ids_.end()) {
+            return std::nullopt;
+        }
+        if (max_time < 0.0) {
+            return reachable;
+        }
+        // Arrival vertices are even; a departure vertex is only an intermediate step
+        graph::VisitReachable(graph_, from_it->second, MinutesToWeight(max_time),
+                              [this, &reachable](graph::VertexId vertex, RouteWeight weight) {
+            if (vertex % 2 == 0) {
+                reachable.push_back({stop_names_[vertex / 2], WeightToMinutes(weight)});
+            }
+        });
+    }
+    std::sort(reachable.begin(), reachable.end(), [](const ReachableStop& lhs, const ReachableStop& rhs) {
+        return std::tie(lhs.time, lhs.stop_name) < std::tie(rhs.time, rhs.stop_name);
+    });
+    return reachable;
+}
+
+Router::RouteMatrix Router::FindRouteMatrix(const std::vector<std::string_view>& sources,
+                                            const std::vector<std::string_view>& targets) const {
+    CheckHasGraph();
+    RouteMatrix matrix(sources.size());
+    std::unordered_map<std::string_view, size_t> first_rows;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (const auto [it, is_new] = first_rows.emplace(sources[i], i); !is_new) {
+            matrix[i] = matrix[it->second];
+            continue;
+        }
+        try {
+            matrix[i] = FindRoutesFrom(sources[i], targets);
+        } catch (...) {
+            matrix[i].assign(targets.size(), std::nullopt);
+        }
+    }
+    return matrix;
+}
+
+std::vector<std::optional<RouteInfo>> Router::FindRoutesFrom(std::string_view from,
+                                                             const std::vector<std::string_view>& targets) const {
+    std::vector<std::optional<RouteInfo>> routes(targets.size());
+    const auto from_it = stop_ids_.find(from);
+    if (from_it == stop_ids_.end()) {
+        return routes;
+    }
+    // Only the known targets missing from the route cache are searched for
+    std::vector<std::string_view> target_names;
+    std::vector<graph::VertexId> target_ids;
+    std::vector<size_t> target_positions;
+    for (size_t i = 0; i < targets.size(); ++i) {
+        const auto to_it = stop_ids_.find(targets[i]);
+        if (to_it == stop_ids_.end() || route_cache_->Find(from_it->second, to_it->second, routes[i])) {
+            continue;
+        }
+        target_names.push_back(targets[i]);
+        target_ids.push_back(to_it->second);
+        target_positions.push_back(i);
+    }
+    if (target_ids.empty()) {
+        return routes;
+    }
+
+    std::vector<std::optional<RouteInfo>> found(target_ids.size());
+    RebuildStaleRouter();
+    if (raptor_) {
+        auto journeys = raptor_->FindJourneys(from, target_names);
+        for (size_t i = 0; i < journeys.size(); ++i) {
+            if (journeys[i]) {
+                found[i] = MakeRouteInfo(*journeys[i]);
+            }
+        }
+    } else {
+        std::visit([&](const auto& engine) {
+            using Engine = typename std::decay_t<decltype(engine)>::element_type;
+            if (!engine) {
+                return;
+            }
+            constexpr bool is_goal_directed = std::is_same_v<Engine, graph::ContractionHierarchy<RouteWeight>>
+                                              || std::is_same_v<Engine, graph::AltRouter<RouteWeight>>;
+            auto add_routes = [this, &found](const auto& routes_from) {
+                for (size_t i = 0; i < routes_from.size(); ++i) {
+                    if (routes_from[i]) {
+                        found[i] = MakeRouteInfo(WeightToMinutes(routes_from[i]->weight), routes_from[i]->edges);
+                    }
+                }
+            };
+            if constexpr (std::is_same_v<Engine, graph::DijkstraRouter<RouteWeight>>) {
+                add_routes(engine->BuildRoutes(from_it->second, target_ids));
+            } else if (is_goal_directed && target_ids.size() > GOAL_DIRECTED_MAX_TARGETS) {
+                // One search, stopped once every target is settled, instead of one
+                // goal-directed search per target. Without a cache, nothing is kept
+                const graph::DijkstraRouter<RouteWeight> search(graph_, 0);
+                add_routes(search.BuildRoutes(from_it->second, target_ids));
+            } else {
+                // The table engines answer each pair by lookup, the goal-directed ones
+                // search per pair for a few targets
+                std::vector<graph::EdgeId>& edges = GetRouteBuffers().edges;
+                for (size_t i = 0; i < target_ids.size(); ++i) {
+                    if (const auto weight = engine->BuildRoute(from_it->second, target_ids[i], edges)) {
+                        found[i] = MakeRouteInfo(WeightToMinutes(*weight), edges);
+                    }
+                }
+            }
+        }, router_);
+    }
+
+    for (size_t i = 0; i < found.size(); ++i) {
+        route_cache_->Insert(from_it->second, target_ids[i], found[i]);
+        routes[target_positions[i]] = std::move(found[i]);
+    }
+    return routes;
+}
+
+RouteEdgeInfo Router::GetEdgeInfo(graph::EdgeId edge_id) const {
+    const uint32_t bus_index = edge_info_.GetBusIndex(edge_id);
+    if (bus_index == RoutingIndex::NO_INDEX) {
+        return {{}, 0, edge_info_.GetTime(edge_id), stop_names_[edge_info_.GetStopIndex(edge_id)]};
+    }
+    return {bus_names_[bus_index], edge_info_.GetSpanCount(edge_id), edge_info_.GetTime(edge_id), {}};
+}
+
+RouteInfo Router::MakeRouteInfo(double total_time, const std::vector<graph::EdgeId>& edges) const {
+    RouteInfo result;
+    result.total_time = total_time;
+    result.edges.reserve(edges.size());
+    for (const auto& edge_id : edges) {
+        result.edges.push_back(GetEdgeInfo(edge_id));
+    }
+    return result;
+}
+
+template <typename Journey>
+RouteInfo Router::MakeRouteInfo(const Journey& journey) {
+    RouteInfo result;
+    result.total_time = journey.total_time;
+    result.edges.reserve(journey.legs.size() * 2);
+    for (const auto& leg : journey.legs) {
+        result.edges.push_back({{}, 0, leg.wait_time, leg.board_stop->name});
+        result.edges.push_back({leg.bus->number, leg.span_count, leg.ride_time, {}});
+    }
+    return result;
+}
+
+LazyRouter::LazyRouter(Launch launch, Builder build)
+    : router_(std::async(launch == Launch::BACKGROUND ? std::launch::async : std::launch::deferred,
+                         std::move(build)).share()) {
+}
+
+const Router& LazyRouter::Get() const {
+    return *router_.get();
+}
+
 } // namespace transport
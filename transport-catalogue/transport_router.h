@@ -1,20 +1,41 @@
 #pragma once 
 
 #include "router.h" 
+#include "dijkstra_router.h"
+#include "contraction_hierarchy.h"
+#include "blocked_router.h"
+#include "alt_router.h"
+#include "isochrone.h"
+#include "raptor_router.h"
+#include "connection_scan_router.h"
+#include "routing_index.h"
+#include "route_weight.h"
+#include "route_cache.h"
+#include "stop_order.h"
+#include "ranges.h"
 #include "transport_catalogue.h" 
 #include "graph.h" 
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
 #include <memory> 
+#include <mutex>
+#include <optional>
+#include <string_view>
 #include <unordered_map> 
+#include <variant>
 #include <vector>
 
 namespace transport { 
 
+// The names are owned by the catalogue the router was built from
 struct RouteEdgeInfo { 
-    std::string bus_name; 
+    std::string_view bus_name;   // empty for a Wait item
     int span_count; 
     double time; 
-    std::string stop_name; 
+    std::string_view stop_name;  // empty for a Bus item
 };
 
 struct RouteInfo {
@@ -22,23 +43,229 @@ struct RouteInfo {
     std::vector<RouteEdgeInfo> edges;
 };
 
+// Route in buffers owned by the querying thread, see Router::FindRouteView
+struct RouteView {
+    double total_time;
+    ranges::Range<const RouteEdgeInfo*> edges;
+};
+
+struct ReachableStop {
+    std::string_view stop_name;
+    double time;
+};
+
+enum class RouterEngine {
+    ALL_PAIRS,                // graph::Router, precomputes the whole V x V table
+    DIJKSTRA,                 // graph::DijkstraRouter, one search per query with a source tree cache
+    CONTRACTION_HIERARCHIES,  // graph::ContractionHierarchy, bidirectional upward search
+    BLOCKED_ALL_PAIRS,        // graph::BlockedRouter, tiled multi-threaded Floyd-Warshall
+    COMPACT_ALL_PAIRS,        // graph::CompactRouter, same with float/uint32 table cells
+    RAPTOR,                   // transport::RaptorRouter, no graph, scans bus routes round by round
+    ALT,                      // graph::AltRouter, A* with landmark lower bounds
+    CONNECTION_SCAN,          // timetables only: no graph, queries without a departure time throw
+};
+
+inline constexpr size_t DEFAULT_ROUTE_CACHE_SIZE = 4096;
+
+struct RoutingSettings {
+    int bus_wait_time = 0;
+    double bus_velocity = 0.0;
+    RouterEngine engine = RouterEngine::ALL_PAIRS;
+    VertexOrder vertex_order = VertexOrder::NAME;  // numbering of the graph vertices, see OrderStops
+    size_t tree_cache_size = graph::DijkstraRouter<RouteWeight>::DEFAULT_CACHE_CAPACITY;
+    size_t thread_count = 0;  // 0 means all hardware threads
+    size_t landmark_count = graph::AltRouter<RouteWeight>::DEFAULT_LANDMARK_COUNT;
+    size_t route_cache_size = DEFAULT_ROUTE_CACHE_SIZE;  // routes kept by Router, 0 disables the cache
+    std::string index_file;   // persisted routing index, empty to always build from scratch
+};
+
 class Router { 
 public: 
+    // [source][target]
+    using RouteMatrix = std::vector<std::vector<std::optional<RouteInfo>>>;
+
     Router() = default; 
     Router(const Catalogue& catalogue, int bus_wait_time, double bus_velocity); 
+    Router(const Catalogue& catalogue, const RoutingSettings& settings);
      
+    // The queries without a departure time throw std::logic_error for the
+    // CONNECTION_SCAN engine, which has no graph to answer them
     std::optional<RouteInfo> FindRoute(std::string_view from, std::string_view to) const; 
+    // Earliest arrival over the bus timetables when leaving at departure_time minutes
+    // after midnight, whatever the routing engine. total_time counts from
+    // departure_time, and the Wait items are the real waits for the boarded trips
+    std::optional<RouteInfo> FindRoute(std::string_view from, std::string_view to, double departure_time) const;
+    // Same route without heap allocations once the per-thread buffers have grown to
+    // the route length. The view is valid until the next FindRouteView call on the
+    // same thread. Bypasses the route cache, whose entries would have to be copied.
+    // The DIJKSTRA engine reads its cached trees but caches no new ones for views
+    std::optional<RouteView> FindRouteView(std::string_view from, std::string_view to) const;
+    // Runs one search per distinct source and answers all targets from it
+    RouteMatrix FindRouteMatrix(const std::vector<std::string_view>& sources,
+                                const std::vector<std::string_view>& targets) const;
+
+    // All stops reachable from `from` within max_time minutes, the origin included,
+    // ordered by arrival time and then by name; std::nullopt for an unknown stop.
+    // One search bounded by max_time, whatever the routing engine
+    std::optional<std::vector<ReachableStop>> FindReachableStops(std::string_view from, double max_time) const;
+
+    // Incremental updates: the catalogue must already contain the change, so a
+    // frozen one has to be thawed first (see Catalogue::Thaw). Only the changed
+    // edges are touched, and the routing engine repairs just the state that depends
+    // on them; a contraction hierarchy is rebuilt once by the next query. Buses may
+    // only go through the stops the router was built with
+    void AddBus(const Catalogue& catalogue, std::string_view bus_name);
+    void RemoveBus(std::string_view bus_name);
+    // Call after Catalogue::SetDistance(from_stop, to_stop, ...). A bus changed in
+    // the catalogue but not passed to AddBus yet is skipped until it is
+    void UpdateDistance(const Catalogue& catalogue, std::string_view from_stop, std::string_view to_stop);
+
+    RouteCache<std::optional<RouteInfo>>::Stats GetRouteCacheStats() const {
+        return route_cache_->GetStats();
+    }
      
 private: 
+    using GraphRouter = std::variant<std::unique_ptr<graph::Router<RouteWeight>>,
+                                     std::unique_ptr<graph::DijkstraRouter<RouteWeight>>,
+                                     std::unique_ptr<graph::ContractionHierarchy<RouteWeight>>,
+                                     std::unique_ptr<graph::BlockedRouter<RouteWeight>>,
+                                     std::unique_ptr<graph::CompactRouter<RouteWeight>>,
+                                     std::unique_ptr<graph::AltRouter<RouteWeight>>>;
+
+    // Edge metadata as parallel arrays indexed by edge id. Names are not copied,
+    // the indices refer to bus_names_ and stop_names_. The arrays can be borrowed
+    // from a loaded RoutingIndex, and are then copied on the first change
+    class EdgeInfoTable {
+    public:
+        struct View {
+            const uint32_t* bus_indices;   // RoutingIndex::NO_INDEX for a Wait edge
+            const uint32_t* stop_indices;  // RoutingIndex::NO_INDEX for a Bus edge
+            const int32_t* span_counts;
+            const double* times;
+        };
+
+        uint32_t GetBusIndex(graph::EdgeId edge_id) const {
+            return is_borrowed_ ? borrowed_.bus_indices[edge_id] : bus_indices_[edge_id];
+        }
+        uint32_t GetStopIndex(graph::EdgeId edge_id) const {
+            return is_borrowed_ ? borrowed_.stop_indices[edge_id] : stop_indices_[edge_id];
+        }
+        int GetSpanCount(graph::EdgeId edge_id) const {
+            return is_borrowed_ ? borrowed_.span_counts[edge_id] : span_counts_[edge_id];
+        }
+        double GetTime(graph::EdgeId edge_id) const {
+            return is_borrowed_ ? borrowed_.times[edge_id] : times_[edge_id];
+        }
+        View GetView() const;
+
+        // The arrays of view, edge_count entries each, must stay valid until the
+        // table is cleared or changed
+        void Borrow(View view, size_t edge_count);
+        void Clear();
+        void Resize(size_t edge_count);
+        void Set(graph::EdgeId edge_id, uint32_t bus_index, uint32_t stop_index, int span_count, double time);
+        void SetTime(graph::EdgeId edge_id, double time);
+        void Add(uint32_t bus_index, uint32_t stop_index, int span_count, double time);
+
+    private:
+        void Own();
+
+        bool is_borrowed_ = false;
+        View borrowed_{};
+        size_t borrowed_size_ = 0;
+        std::vector<uint32_t> bus_indices_;
+        std::vector<uint32_t> stop_indices_;
+        std::vector<int32_t> span_counts_;
+        std::vector<double> times_;
+    };
+
+    // Bus edges of a bus are added together, so they have consecutive ids
+    struct EdgeRange {
+        graph::EdgeId first;
+        size_t count;
+    };
+
     void BuildGraph(const Catalogue& catalogue);
+    // Calls handle_ride(from, to, span_count, travel_time) for every ride of the
+    // bus, in the order of its edges; from and to are positions in bus.stops
+    template <typename RideHandler>
+    void ForEachRide(const Catalogue& catalogue, const Bus& bus, RideHandler handle_ride) const;
+    // Writes the edges of the bus from first_edge on, over existing edges or
+    // appended to the graph, and adds the changes to updates
+    void AddBusEdges(const Catalogue& catalogue, const Bus& bus, graph::EdgeId first_edge,
+                     std::vector<graph::EdgeUpdate<RouteWeight>>& updates);
+    // First id of count consecutive free edges: taken from free_edges_, or
+    // GetEdgeCount() when they have to be appended
+    graph::EdgeId AllocateEdges(size_t count);
+    void FreeEdges(EdgeRange edges);
+    static size_t CountRides(const Bus& bus);
+    // Arrival vertices of the stops of the bus
+    std::vector<graph::VertexId> GetStopVertices(const Bus& bus) const;
+    // Index of the bus in bus_names_, assigned on first use
+    uint32_t GetBusIndex(const Bus& bus);
+    std::vector<graph::EdgeUpdate<RouteWeight>> RemoveBusEdges(std::string_view bus_name);
+    void RepairRouter(const std::vector<graph::EdgeUpdate<RouteWeight>>& updates);
+    // Rebuilds the contraction hierarchy if updates came since it was built. Called
+    // by the queries before they use router_
+    void RebuildStaleRouter() const;
+    void BuildRouter();
+    std::vector<std::optional<RouteInfo>> FindRoutesFrom(std::string_view from,
+                                                         const std::vector<std::string_view>& targets) const;
+    RouteEdgeInfo GetEdgeInfo(graph::EdgeId edge_id) const;
+    // Throws for the CONNECTION_SCAN engine
+    void CheckHasGraph() const;
+    RouteInfo MakeRouteInfo(double total_time, const std::vector<graph::EdgeId>& edges) const;
+    // For the journeys of RaptorRouter and ConnectionScanRouter
+    template <typename Journey>
+    static RouteInfo MakeRouteInfo(const Journey& journey);
+    uint64_t ComputeIndexKey(const Catalogue& catalogue) const;
+    bool LoadIndex(const Catalogue& catalogue, uint64_t key);
+    void SaveIndex(uint64_t key) const;
     
-    int bus_wait_time_ = 0; 
-    double bus_velocity_ = 0.0; 
+    RoutingSettings settings_;
      
-    graph::DirectedWeightedGraph<double> graph_; 
-    std::unique_ptr<graph::Router<double>> router_; 
-    std::unordered_map<graph::EdgeId, RouteEdgeInfo> edge_info_; 
-    std::unordered_map<std::string, graph::VertexId> stop_ids_; 
+    graph::DirectedWeightedGraph<RouteWeight> graph_; 
+    mutable GraphRouter router_;  // mutable for the deferred rebuild, see RebuildStaleRouter
+    std::unique_ptr<RaptorRouter> raptor_;
+    std::unique_ptr<ConnectionScanRouter> timetable_;  // null until some bus has departures
+    std::unique_ptr<RoutingIndex> index_;  // backs graph_, edge_info_ and the table of router_ when loaded from a file
+    // Built routes, cleared whenever the graph is rebuilt
+    std::unique_ptr<RouteCache<std::optional<RouteInfo>>> route_cache_
+        = std::make_unique<RouteCache<std::optional<RouteInfo>>>(0);
+    // A contraction hierarchy is rebuilt once per batch of updates, by the first
+    // query after them, rather than on every update
+    struct StaleRouter {
+        std::mutex mutex;
+        std::atomic<bool> is_stale = false;
+    };
+    std::unique_ptr<StaleRouter> stale_router_ = std::make_unique<StaleRouter>();
+    EdgeInfoTable edge_info_;
+    std::unordered_map<std::string_view, graph::VertexId> stop_ids_;  // names are owned by the catalogue
+    std::vector<std::string_view> stop_names_;  // stop with arrival vertex 2 * i, in settings_.vertex_order
+    std::unordered_map<std::string_view, uint32_t> bus_ids_;
+    std::vector<std::string_view> bus_names_;   // bus with index i, name-sorted when built from a catalogue
+    std::unordered_map<std::string_view, EdgeRange> bus_edges_;
+    std::vector<EdgeRange> free_edges_;  // removed edges, by first id, for reuse
 }; 
 
+// Router built on first use (DEFERRED) or right away on a background thread
+// (BACKGROUND); Get() blocks until it is ready and rethrows a build error.
+// Whatever the builder reads must not change while the router is being built
+class LazyRouter {
+public:
+    enum class Launch {
+        DEFERRED,
+        BACKGROUND,
+    };
+
+    using Builder = std::function<std::shared_ptr<const Router>()>;
+
+    LazyRouter(Launch launch, Builder build);
+
+    const Router& Get() const;
+
+private:
+    std::shared_future<std::shared_ptr<const Router>> router_;
+};
+
 } // namespace transport 
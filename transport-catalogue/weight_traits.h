@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+namespace graph {
+
+// Non-negative duration in hundredths of a second. Half the size of a double, and
+// sums of edge weights are exact, so equal routes always get equal weights.
+// Infinity() is the largest value and sums saturate at it, which keeps "no route"
+// infinite through additions the way +inf does for floating point weights
+class FixedPointWeight {
+public:
+    static constexpr uint32_t TICKS_PER_SECOND = 100;
+
+    constexpr FixedPointWeight() = default;
+
+    static constexpr FixedPointWeight FromTicks(uint32_t ticks) {
+        FixedPointWeight weight;
+        weight.ticks_ = ticks;
+        return weight;
+    }
+    static constexpr FixedPointWeight Infinity() {
+        return FromTicks(std::numeric_limits<uint32_t>::max());
+    }
+    // Rounds to the nearest tick; values too large to represent become Infinity()
+    static FixedPointWeight FromSeconds(double seconds) {
+        const double ticks = std::round(seconds * TICKS_PER_SECOND);
+        if (!(ticks < static_cast<double>(std::numeric_limits<uint32_t>::max()))) {
+            return Infinity();
+        }
+        return FromTicks(ticks > 0.0 ? static_cast<uint32_t>(ticks) : 0);
+    }
+
+    constexpr uint32_t GetTicks() const {
+        return ticks_;
+    }
+    double ToSeconds() const {
+        return *this == Infinity() ? std::numeric_limits<double>::infinity()
+                                   : static_cast<double>(ticks_) / TICKS_PER_SECOND;
+    }
+
+    constexpr bool operator==(FixedPointWeight other) const {
+        return ticks_ == other.ticks_;
+    }
+    constexpr bool operator!=(FixedPointWeight other) const {
+        return ticks_ != other.ticks_;
+    }
+    constexpr bool operator<(FixedPointWeight other) const {
+        return ticks_ < other.ticks_;
+    }
+    constexpr bool operator>(FixedPointWeight other) const {
+        return ticks_ > other.ticks_;
+    }
+    constexpr bool operator<=(FixedPointWeight other) const {
+        return ticks_ <= other.ticks_;
+    }
+    constexpr bool operator>=(FixedPointWeight other) const {
+        return ticks_ >= other.ticks_;
+    }
+
+private:
+    uint32_t ticks_ = 0;
+};
+
+// What the routers need to know about a weight type at compile time:
+//   ZERO_WEIGHT      the weight of an empty route,
+//   INFINITE_WEIGHT  "no route", greater than any other weight,
+//   Add              a sum that stays INFINITE_WEIGHT if either term is,
+//   CompactWeight    the 4-byte cell type of the compact all-pairs table.
+// Routers add weights with operator+, which for the supported types is Add
+template <typename Weight, typename = void>
+struct WeightTraits;
+
+template <typename Weight>
+struct WeightTraits<Weight, std::enable_if_t<std::is_floating_point_v<Weight>>> {
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr Weight INFINITE_WEIGHT = std::numeric_limits<Weight>::infinity();
+    using CompactWeight = float;
+
+    static constexpr Weight Add(Weight lhs, Weight rhs) {
+        return lhs + rhs;
+    }
+};
+
+template <>
+struct WeightTraits<FixedPointWeight> {
+    static constexpr FixedPointWeight ZERO_WEIGHT{};
+    static constexpr FixedPointWeight INFINITE_WEIGHT = FixedPointWeight::Infinity();
+    using CompactWeight = FixedPointWeight;
+
+    // Branchless, so loops over weight arrays still vectorize
+    static constexpr FixedPointWeight Add(FixedPointWeight lhs, FixedPointWeight rhs) {
+        const uint32_t sum = lhs.GetTicks() + rhs.GetTicks();
+        return FixedPointWeight::FromTicks(sum | (0u - static_cast<uint32_t>(sum < lhs.GetTicks())));
+    }
+};
+
+constexpr FixedPointWeight operator+(FixedPointWeight lhs, FixedPointWeight rhs) {
+    return WeightTraits<FixedPointWeight>::Add(lhs, rhs);
+}
+
+// Only for lhs >= rhs, both finite
+constexpr FixedPointWeight operator-(FixedPointWeight lhs, FixedPointWeight rhs) {
+    return FixedPointWeight::FromTicks(lhs.GetTicks() - rhs.GetTicks());
+}
+
+}  // namespace graph